@@ -0,0 +1,58 @@
+#include "CachedVertices.h"
+#include <algorithm>
+#include <iostream>
+
+CachedVertices::CachedVertices(sf::PrimitiveType type)
+    : m_type(type), m_buffer(type, sf::VertexBuffer::Usage::Dynamic)
+{
+}
+
+std::vector<sf::Vertex>& CachedVertices::edit()
+{
+    m_uploadedCount = 0;
+    return m_vertices;
+}
+
+void CachedVertices::append(const sf::Vertex& vertex)
+{
+    m_vertices.push_back(vertex);
+}
+
+const std::vector<sf::Vertex>& CachedVertices::getVertices() const
+{
+    return m_vertices;
+}
+
+void CachedVertices::draw(sf::RenderTarget& target, const sf::RenderStates& states) const
+{
+    if (m_vertices.empty()) return;
+
+    if (!sf::VertexBuffer::isAvailable())
+    {
+        target.draw(m_vertices.data(), m_vertices.size(), m_type, states);
+        return;
+    }
+
+    if (m_uploadedCount < m_vertices.size())
+    {
+        // Only grow the buffer, a smaller shape just draws fewer of the vertices already there.
+        // It grows by doubling so appending a vertex at a time doesn't reallocate every time
+        bool ok = true;
+        if (m_buffer.getVertexCount() < m_vertices.size())
+        {
+            ok = m_buffer.create(std::max(m_vertices.size(), m_buffer.getVertexCount() * 2));
+            m_uploadedCount = 0;
+        }
+        if (ok)
+            ok = m_buffer.update(m_vertices.data() + m_uploadedCount, m_vertices.size() - m_uploadedCount, static_cast<unsigned int>(m_uploadedCount));
+        if (!ok)
+        {
+            std::cerr << "Failed to upload " << m_vertices.size() << " vertices, drawing from host memory instead\n";
+            target.draw(m_vertices.data(), m_vertices.size(), m_type, states);
+            return;
+        }
+        m_uploadedCount = m_vertices.size();
+    }
+
+    target.draw(m_buffer, 0, m_vertices.size(), states);
+}
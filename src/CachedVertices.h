@@ -0,0 +1,26 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// Vertices for a shape that only change when its geometry does.
+// Fill them through edit() whenever the shape changes and draw() reuses them every frame after that. They live in a
+// GPU vertex buffer when the driver has them so nothing is re-uploaded per frame, otherwise they're drawn from the host copy.
+class CachedVertices
+{
+public:
+    explicit CachedVertices(sf::PrimitiveType type);
+
+    // Marks the vertices as changed, they get uploaded on the next draw
+    std::vector<sf::Vertex>& edit();
+    // Adds one vertex to the end, only the newly appended ones get uploaded on the next draw
+    void append(const sf::Vertex& vertex);
+    const std::vector<sf::Vertex>& getVertices() const;
+    void draw(sf::RenderTarget& target, const sf::RenderStates& states) const;
+
+private:
+    sf::PrimitiveType m_type;
+    std::vector<sf::Vertex> m_vertices;
+    // Uploading needs a GL context which only draw() is guaranteed to have, so it's done lazily from there
+    mutable sf::VertexBuffer m_buffer;
+    mutable std::size_t m_uploadedCount = 0; // Vertices before this are already in m_buffer
+};
@@ -49,10 +49,13 @@ void CircularArcShape::updateShape()
     // Start angle from center to p1
     float angleStart = std::atan2(p1.y - m_arcCenter.y, p1.x - m_arcCenter.x);
 
-    // angleStep is total arc angle divided by (resolution - 1)
-    float angleStep = m_arcAngle / static_cast<float>(m_resolution - 1);
+    // Just enough points to keep every segment within m_maxChordError of the true arc
+    unsigned int pointCount = arcSegmentsForError(m_radius, m_arcAngle, m_maxChordError, 1, m_resolution - 1) + 1;
 
-    for (unsigned int i = 0; i < m_resolution; ++i)
+    // angleStep is total arc angle divided by (pointCount - 1)
+    float angleStep = m_arcAngle / static_cast<float>(pointCount - 1);
+
+    for (unsigned int i = 0; i < pointCount; ++i)
     {
         float angle = angleStart + i * angleStep;
         float x = std::cos(angle) * m_radius;
@@ -60,6 +63,7 @@ void CircularArcShape::updateShape()
         m_points.emplace_back(m_arcCenter + sf::Vector2f(x, y));
     }
 
+    m_verticesDirty = true;
     update(); // refresh SFML shape or equivalent
 }
 
@@ -84,14 +88,19 @@ void CircularArcShape::draw(sf::RenderTarget& target, sf::RenderStates states) c
 {
     states.transform *= getTransform();
 
-    sf::VertexArray arc(sf::PrimitiveType::LineStrip, m_points.size());
-    for (std::size_t i = 0; i < m_points.size(); ++i)
+    if (m_verticesDirty || m_builtColor != getOutlineColor())
     {
-        arc[i].position = m_points[i];
-        arc[i].color = getOutlineColor();
+        std::vector<sf::Vertex>& arc = m_vertices.edit();
+        arc.resize(m_points.size());
+        for (std::size_t i = 0; i < m_points.size(); ++i)
+        {
+            arc[i] = sf::Vertex{ m_points[i], getOutlineColor() };
+        }
+        m_builtColor = getOutlineColor();
+        m_verticesDirty = false;
     }
 
-    target.draw(arc, states);
+    m_vertices.draw(target, states);
 }
 
 bool CircularArcShape::isComplete()
@@ -116,3 +125,11 @@ void CircularArcShape::setMarkerPos(Entity* marker, const sf::Vector2f& position
     marker->cShape->circle.setPosition(position);
     updateShape();
 }
+
+bool CircularArcShape::setMaxChordError(float maxError)
+{
+    if (maxError == m_maxChordError) return false;
+    m_maxChordError = maxError;
+    updateShape();
+    return true;
+}
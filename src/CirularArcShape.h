@@ -2,11 +2,13 @@
 #include <vector>
 #include "Entity.h"
 #include "Util.h"
+#include "CachedVertices.h"
 #include <SFML/Graphics.hpp>
 
 class CircularArcShape : public sf::Shape {
 public:
-    CircularArcShape(unsigned int resolution = 200);
+    static constexpr ShapeKind shapeKind = ShapeKind::CircularArc;
+    CircularArcShape(unsigned int resolution = 2048);
 
     virtual std::size_t getPointCount() const override;
     virtual sf::Vector2f getPoint(std::size_t index) const override;
@@ -17,15 +19,23 @@ public:
     Entity* getMarker(const size_t index) const;
     void setMarkerPos(const size_t index, const sf::Vector2f& position);
     void setMarkerPos(Entity* marker, const sf::Vector2f& position);
+    // Returns true if the arc was re-tessellated
+    bool setMaxChordError(float maxError);
 
 private:
     float m_radius = 0.f;
     float m_arcAngle = 0.f;
     sf::Vector2f m_arcCenter;
-    unsigned int m_resolution;
+    unsigned int m_resolution; // Most points the arc may use, the actual count comes from m_maxChordError
+    float m_maxChordError = defaultMaxChordError;
 
     std::vector<sf::Vector2f> m_points;
     std::vector<Entity*> m_markers;
 
+    // Rebuilt when updateShape() changes the points or the outline colour changes, not every draw
+    mutable CachedVertices m_vertices{ sf::PrimitiveType::LineStrip };
+    mutable bool m_verticesDirty = true;
+    mutable sf::Color m_builtColor;
+
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
 };
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include "SlotMap.h"
+
+class Entity;
+
+// One element of a component array, the component plus the entity it belongs to so a system walking the array can get back to it
+template<typename T>
+struct PackedComponent
+{
+	T component;
+	Entity* entity = nullptr;
+};
+
+// Every T of every entity in one packed array
+template<typename T>
+SlotMap<PackedComponent<T>>& componentStore()
+{
+	static SlotMap<PackedComponent<T>> store;
+	return store;
+}
+
+// An entity's T, which lives in componentStore<T>() rather than on the heap by itself.
+// Used the same way as the unique_ptr it replaced: assign a make_unique to attach one, test it, then use ->.
+// Components move around in the array as others are added and removed, so don't keep a pointer or reference to one
+// across creating or destroying entities, go back through the entity instead.
+template<typename T>
+class Component
+{
+	SlotHandle m_handle;
+	Entity* m_entity;
+
+public:
+	explicit Component(Entity* entity) : m_entity(entity) {}
+	Component(const Component&) = delete;
+	Component& operator=(const Component&) = delete;
+	~Component() { reset(); }
+
+	Component& operator=(std::unique_ptr<T> component)
+	{
+		reset();
+		if (component) m_handle = componentStore<T>().insert(PackedComponent<T>{ std::move(*component), m_entity });
+		return *this;
+	}
+
+	void reset()
+	{
+		componentStore<T>().remove(m_handle);
+		m_handle = SlotHandle{};
+	}
+
+	T* get() const
+	{
+		PackedComponent<T>* packed = componentStore<T>().get(m_handle);
+		return packed ? &packed->component : nullptr;
+	}
+	T* operator->() const { return get(); }
+	T& operator*() const { return *get(); }
+	explicit operator bool() const { return !m_handle.isNull(); }
+	bool operator==(std::nullptr_t) const { return m_handle.isNull(); }
+};
@@ -5,6 +5,8 @@
 #include "Entity.h"
 #include <map>
 #include "RayCollisionBuffers.h"
+#include "Emitter.h"
+#include "SlotMap.h"
 class Entity;
 
 
@@ -35,13 +37,41 @@ public:
 };
 
 
+// Which sf::Shape subclass a CCustomShape holds, each shape class declares its own as a static shapeKind member
+enum class ShapeKind {
+	Other,
+	Lens,
+	DemoPrism,
+	CustomPolygonPrism,
+	CircularArc,
+	Detector,
+	Count
+};
+
+template<typename T>
+constexpr ShapeKind shapeKindOf()
+{
+	if constexpr (requires { T::shapeKind; }) return T::shapeKind;
+	else return ShapeKind::Other;
+}
+
 class CCustomShape {
 public:
 	std::unique_ptr<sf::Shape> customShape;
+	// Known at construction from the static type, so the hot loops never need dynamic_cast to find out what the shape is
+	ShapeKind kind = ShapeKind::Other;
 
-	CCustomShape(std::unique_ptr<sf::Shape> shape)
-		: customShape(std::move(shape))
+	template<typename T>
+	CCustomShape(std::unique_ptr<T> shape)
+		: customShape(std::move(shape)), kind(shapeKindOf<T>())
 	{}
+
+	// Cheap replacement for dynamic_cast, nullptr if the shape isn't a T
+	template<typename T>
+	T* as() const
+	{
+		return kind == T::shapeKind ? static_cast<T*>(customShape.get()) : nullptr;
+	}
 };
 
 
@@ -95,27 +125,38 @@ enum class MarkerRole {
 	// Point light marker
 	PointLightMarker,
 	ColouredPointLightMarker,
+	// Emitter origin and the marker it points towards
+	EmitterMarker,
+	EmitterDirectionMarker,
 	// Line segment mirror marker
-	LineMirrorMarker
+	LineMirrorMarker,
+	// Detector end points
+	DetectorMarker
 };
 
 struct EntityTag {};
 struct RayTag {};
+struct EmitterTag {};
 
 class CMarker {
 	MarkerRole role;
 	Entity* targetEntity = nullptr; // The entity this marker modifies
-	RayData* targetRay = nullptr; // The ray this marker modifies, if applicable
-	std::vector<RayData*> targetRays;  // NEW: Store associated rays
+	// Light sources live in slot maps and move around in memory, so hold handles rather than pointers to them
+	SlotHandle targetRay; // The ray this marker modifies, if applicable
+	SlotHandle targetEmitter; // The emitter this marker moves, if applicable
 public:
 	// Constructor for Entity*
 	explicit CMarker(EntityTag,MarkerRole rolee, Entity* targEntity)
 		:role(rolee), targetEntity(targEntity) {
 	}
-	// Constructor for RayData*
-	explicit CMarker(RayTag, MarkerRole role, RayData* ray)
+	// Constructor for a ray in Simulation::m_lightSources
+	explicit CMarker(RayTag, MarkerRole role, SlotHandle ray)
 		: role(role), targetRay(ray) {
 	}
+	// Constructor for an emitter in Simulation::m_emitters
+	explicit CMarker(EmitterTag, MarkerRole role, SlotHandle emitter)
+		: role(role), targetEmitter(emitter) {
+	}
 	MarkerRole getRole() const
 	{
 		return role;
@@ -125,33 +166,14 @@ public:
 		return targetEntity;
 	}
 
-	RayData* getTargetRay() const 
+	SlotHandle getTargetRay() const 
 	{
 		return targetRay;
 	}
 
-	RayData* getTargetRayAtIndex(size_t index) const 
-	{
-		if (index < targetRays.size())
-		{
-			return targetRays[index];
-		}
-		return nullptr; 
-	}
-
-	void addTargetRay(RayData* ray) 
-	{
-		targetRays.push_back(ray);
-	}
-
-	std::vector<RayData*>& getRays()
-	{
-		return targetRays;
-	}
-
-	void clearRays()
+	SlotHandle getTargetEmitter() const
 	{
-		targetRays.clear();
+		return targetEmitter;
 	}
 };
 
@@ -73,6 +73,13 @@ void MyLensShape::setHeight(float newHeight)
     m_height = newHeight;
     update();
 }
+bool MyLensShape::setMaxChordError(float maxError)
+{
+    if (maxError == m_maxChordError) return false;
+    m_maxChordError = maxError;
+    update();
+    return true;
+}
 
 // Private methods
 
@@ -100,7 +107,7 @@ void MyLensShape::sampleArc(std::vector<sf::Vector2f>& out,
     }
 }
 
-void MyLensShape::triangulate()
+void MyLensShape::triangulate() const
 {
     using Coord = double;
     using Point = std::array<Coord, 2>;
@@ -154,19 +161,24 @@ void MyLensShape::update()
     }
     m_points.push_back(topLeft);
     m_points.push_back(topRight);
+    // Each side gets just enough segments to stay within m_maxChordError of the true arc, so a small or nearly flat lens
+    // doesn't hand the kernel hundreds of pointless edges
+    const unsigned int minArcSegments = 4;
     if (rightCircleValid)
     {
-        sampleArc(m_points, rightCircle.center, topRight, bottomRight, rightCircle.radius, m_resolution, rightCircle.angle, rightInset, true);
+        unsigned int segments = arcSegmentsForError(rightCircle.radius, rightCircle.angle, m_maxChordError, minArcSegments, m_resolution);
+        sampleArc(m_points, rightCircle.center, topRight, bottomRight, rightCircle.radius, segments, rightCircle.angle, rightInset, true);
     }
     m_points.push_back(bottomRight);
     m_points.push_back(bottomLeft);
     if (leftCircleValid)
     {
-        sampleArc(m_points, leftCircle.center, bottomLeft, topLeft, leftCircle.radius, m_resolution, leftCircle.angle, leftInset, false);
+        unsigned int segments = arcSegmentsForError(leftCircle.radius, leftCircle.angle, m_maxChordError, minArcSegments, m_resolution);
+        sampleArc(m_points, leftCircle.center, bottomLeft, topLeft, leftCircle.radius, segments, leftCircle.angle, leftInset, false);
     }
     setOrigin(sf::Vector2f(m_width / 2.0f, m_height / 2.0f));
     updateMarkers();
-    triangulate();
+    m_verticesDirty = true;
     sf::Shape::update();
 }
 
@@ -197,39 +209,55 @@ void MyLensShape::setMarkerEntities(Entity* leftMarker, Entity* rightMarker, Ent
     updateMarkers();
 }
 
+void MyLensShape::rebuildVertices() const
+{
+    // Colour only changes don't move any points so the old triangulation still holds
+    if (m_verticesDirty)
+    {
+        triangulate();
+    }
+
+    // Triangles from the earcut indices
+    std::vector<sf::Vertex>& fill = m_fillVertices.edit();
+    fill.resize(m_indices.size());
+    for (size_t i = 0; i < m_indices.size(); ++i)
+    {
+        fill[i] = sf::Vertex{ m_points[m_indices[i]], getFillColor() };
+    }
+
+    // Outline as a closed line strip
+    std::vector<sf::Vertex>& outline = m_outlineVertices.edit();
+    outline.clear();
+    if (!m_points.empty())
+    {
+        outline.reserve(m_points.size() + 1);
+        for (const sf::Vector2f& p : m_points)
+        {
+            outline.push_back(sf::Vertex{ p, getOutlineColor() });
+        }
+        outline.push_back(sf::Vertex{ m_points[0], getOutlineColor() });
+    }
+
+    m_builtFillColor = getFillColor();
+    m_builtOutlineColor = getOutlineColor();
+    m_verticesDirty = false;
+}
+
 void MyLensShape::draw(sf::RenderTarget& target, sf::RenderStates states) const
 {
     // Apply transform of the shape
     states.transform *= getTransform();
 
-    // Create vertex array for triangles
-    sf::VertexArray va(sf::PrimitiveType::Triangles, m_indices.size());
-
-    for (size_t i = 0; i < m_indices.size(); ++i)
+    // Moving the lens only changes the transform, the vertices are only rebuilt when its geometry or colours change
+    if (m_verticesDirty || m_builtFillColor != getFillColor() || m_builtOutlineColor != getOutlineColor())
     {
-        uint32_t index = m_indices[i];
-        sf::Vector2f pos = m_points[index];
-        va[i].position = pos;
-
-        // Set color or other attributes here
-        va[i].color = getFillColor();
+        rebuildVertices();
     }
 
-    // Draw the vertex array
-    target.draw(va, states);
+    m_fillVertices.draw(target, states);
 
-    // Optionally draw outline with sf::LinesStrip or sf::LineLoop:
     if (getOutlineThickness() != 0)
     {
-        sf::VertexArray outline(sf::PrimitiveType::LineStrip, m_points.size() + 1);
-        for (size_t i = 0; i < m_points.size(); ++i)
-        {
-            outline[i].position = m_points[i];
-            outline[i].color = getOutlineColor();
-        }
-        outline[m_points.size()].position = m_points[0];
-        outline[m_points.size()].color = getOutlineColor();
-
-        target.draw(outline, states);
+        m_outlineVertices.draw(target, states);
     }
 }
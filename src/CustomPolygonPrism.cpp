@@ -33,10 +33,11 @@ void CustomPolygonPrism::addMarker(Entity* marker)
 void CustomPolygonPrism::addPoint(sf::Vector2f point)
 {
     m_points.push_back(point);
-    updateShapeData();
+    m_outline.append(sf::Vertex{ point, sf::Color::White });
+    m_triangulationDirty = true;
 }
 
-void CustomPolygonPrism::updateShapeData()
+void CustomPolygonPrism::triangulate() const
 {
     using Coord = float;
     using Point = std::array<Coord, 2>;
@@ -51,16 +52,17 @@ void CustomPolygonPrism::updateShapeData()
     // Triangulates shape using earcut 
     std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
     // m_triangulated shape stores a bunch of triangles which we can draw
-    m_triangulatedShape.clear();
-    m_triangulatedShape.setPrimitiveType(sf::PrimitiveType::Triangles);
+    std::vector<sf::Vertex>& triangles = m_triangulatedShape.edit();
+    triangles.clear();
+    triangles.reserve(indices.size());
 
     for (uint32_t i : indices) 
     {
         const sf::Vector2f& pt = m_points[i];
-        m_triangulatedShape.append(sf::Vertex(pt, getFillColor()));  // Set each triangle to correct fill colour
-    
+        triangles.push_back(sf::Vertex{ pt, getFillColor() });  // Set each triangle to correct fill colour
     }
-    sf::Shape::update();
+    m_triangulatedColor = getFillColor();
+    m_triangulationDirty = false;
 }
 void CustomPolygonPrism::draw(sf::RenderTarget& target, sf::RenderStates states) const
 {
@@ -69,39 +71,25 @@ void CustomPolygonPrism::draw(sf::RenderTarget& target, sf::RenderStates states)
 
     // Draw the triangulated shape if the shape is marked as completed
     if (m_isShapeComplete)
-        target.draw(m_triangulatedShape, states);
-
-    // We add an extra point if preview which is the point of the mouse which we pass in 
-    size_t basePointCount = m_points.size();
-    size_t outlineCount = basePointCount + (m_hasPreview ? 1 : 0) + (m_isShapeComplete ? 1 : 0);
-
-    sf::VertexArray outline(sf::PrimitiveType::LineStrip, outlineCount);
-
-    size_t i = 0;
-
-    // Add actual points
-    for (; i < basePointCount; i++)
     {
-        outline[i].position = m_points[i];
-        outline[i].color = sf::Color::White;
+        if (m_triangulationDirty || m_triangulatedColor != getFillColor())
+            triangulate();
+        m_triangulatedShape.draw(target, states);
     }
 
-    // Add preview point if active
-    if (m_hasPreview)
-    {
-        outline[i].position = m_previewPoint;
-        outline[i].color = sf::Color(180, 180, 180);  // Light gray for preview
-        i++;
-    }
+    // The placed points are cached, only the segment from the last one to the preview point (or back to the start) changes
+    m_outline.draw(target, states);
 
-    // Close loop if shape is complete
-    if (m_isShapeComplete && !m_points.empty())
+    if (!m_points.empty() && (m_hasPreview || m_isShapeComplete))
     {
-        outline[i].position = m_points[0];
-        outline[i].color = sf::Color::White;
+        sf::Vertex tail[2];
+        tail[0] = sf::Vertex{ m_points.back(), sf::Color::White };
+        if (m_hasPreview)
+            tail[1] = sf::Vertex{ m_previewPoint, sf::Color(180, 180, 180) };  // Light gray for preview
+        else
+            tail[1] = sf::Vertex{ m_points[0], sf::Color::White };  // Close loop if shape is complete
+        target.draw(tail, 2, sf::PrimitiveType::Lines, states);
     }
-
-    target.draw(outline, states);
 }
 
 void CustomPolygonPrism::setPreviewPoint(const sf::Vector2f& point)
@@ -119,6 +107,8 @@ void CustomPolygonPrism::setShapeComplete()
 {
     m_isShapeComplete = true;
     clearPreview();
+    // Bounds were left stale while points were being added, nothing needs them until the shape is complete
+    sf::Shape::update();
 }
 
 bool CustomPolygonPrism::getShapeComplete() const
@@ -6,15 +6,16 @@
 #include "Util.h"
 #include "Entity.h"
 #include "earcut.hpp"
+#include "CachedVertices.h"
 
 class CustomPolygonPrism : public sf::Shape {
 public:
+    static constexpr ShapeKind shapeKind = ShapeKind::CustomPolygonPrism;
     CustomPolygonPrism(Entity* initialMarker);
     virtual std::size_t getPointCount() const override;
     virtual sf::Vector2f getPoint(std::size_t index) const override;
     void addMarker(Entity* marker);
     void addPoint(sf::Vector2f);
-    void updateShapeData();
     void setPreviewPoint(const sf::Vector2f& point);
     void clearPreview();
     void setShapeComplete();
@@ -25,7 +26,15 @@ public:
 private:
     std::vector<sf::Vector2f> m_points;
     std::vector<Entity*> m_markers;
-    sf::VertexArray m_triangulatedShape;
+
+    // Only triangulated when it's drawn complete and the points or fill colour changed since last time,
+    // so placing a vertex is O(1) however big the outline is
+    mutable CachedVertices m_triangulatedShape{ sf::PrimitiveType::Triangles };
+    mutable bool m_triangulationDirty = true;
+    mutable sf::Color m_triangulatedColor;
+    // The placed points as a line strip, appended to as points are added
+    CachedVertices m_outline{ sf::PrimitiveType::LineStrip };
+    void triangulate() const;
 
     // Header or private section of your class
     bool m_isShapeComplete = false;
@@ -0,0 +1,96 @@
+#include "DetectorShape.h"
+#include "Vec2fExtension.h"
+#include <algorithm>
+#include <iostream>
+
+DetectorShape::DetectorShape()
+    : m_markers(2, nullptr) {
+}
+
+void DetectorShape::addMarker(Entity* marker)
+{
+    for (size_t i = 0; i < m_markers.size(); ++i)
+    {
+        if (m_markers[i] == nullptr)
+        {
+            m_markers[i] = marker;
+            if (isComplete()) updateShape();
+            return;
+        }
+    }
+
+    std::cerr << "Max of 2 markers already added.\n";
+}
+
+void DetectorShape::updateShape()
+{
+    if (!isComplete()) return;
+
+    // The first marker is position 0 in the histogram and the second is the last position bin
+    m_points.clear();
+    m_points.push_back(m_markers[0]->cShape->circle.getPosition());
+    m_points.push_back(m_markers[1]->cShape->circle.getPosition());
+
+    update();
+}
+
+std::size_t DetectorShape::getPointCount() const
+{
+    return m_points.size();
+}
+
+sf::Vector2f DetectorShape::getPoint(std::size_t index) const
+{
+    if (index >= m_points.size())
+    {
+        std::cerr << "DetectorShape: index out of bounds.\n";
+        return sf::Vector2f();
+    }
+
+    return m_points[index];
+}
+
+void DetectorShape::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    if (m_points.size() < 2) return;
+    states.transform *= getTransform();
+
+    // Hatch the back of the line so it doesn't get mistaken for a line mirror
+    sf::Vector2f along = m_points[1] - m_points[0];
+    float length = magnitude(along);
+    if (length == 0.0f) return;
+    along /= length;
+    sf::Vector2f normal(-along.y, along.x);
+
+    const float hatchSpacing = 8.0f;
+    const float hatchLength = 4.0f;
+    int hatchCount = static_cast<int>(length / hatchSpacing);
+
+    sf::VertexArray lines(sf::PrimitiveType::Lines);
+    lines.append(sf::Vertex{ m_points[0], getOutlineColor() });
+    lines.append(sf::Vertex{ m_points[1], getOutlineColor() });
+    for (int i = 0; i <= hatchCount; ++i)
+    {
+        sf::Vector2f p = m_points[0] + along * (i * hatchSpacing);
+        lines.append(sf::Vertex{ p, getOutlineColor() });
+        lines.append(sf::Vertex{ p + (normal - along) * hatchLength, getOutlineColor() });
+    }
+
+    target.draw(lines, states);
+}
+
+bool DetectorShape::isComplete() const
+{
+    return std::all_of(m_markers.begin(), m_markers.end(), [](Entity* e) { return e != nullptr; });
+}
+
+Entity* DetectorShape::getMarker(const size_t index) const
+{
+    return m_markers[index];
+}
+
+void DetectorShape::setMarkerPos(Entity* marker, const sf::Vector2f& position)
+{
+    marker->cShape->circle.setPosition(position);
+    updateShape();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include "Entity.h"
+#include <SFML/Graphics.hpp>
+
+// A flat screen between two markers. Rays that hit it are absorbed and binned into a histogram on the GPU
+// so it acts like a spectrometer rather than a mirror.
+class DetectorShape : public sf::Shape {
+public:
+    static constexpr ShapeKind shapeKind = ShapeKind::Detector;
+    DetectorShape();
+
+    virtual std::size_t getPointCount() const override;
+    virtual sf::Vector2f getPoint(std::size_t index) const override;
+
+    void addMarker(Entity* marker);
+    void updateShape();
+    bool isComplete() const;
+    Entity* getMarker(const size_t index) const;
+    void setMarkerPos(Entity* marker, const sf::Vector2f& position);
+
+private:
+    std::vector<sf::Vector2f> m_points;
+    std::vector<Entity*> m_markers;
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/System/Vector2.hpp>
+
+// Order matters, the kernel gets this as an int
+enum class EmitterType {
+	Point,      // Rays evenly spaced around a full circle
+	Collimated, // Parallel rays spread across width
+	Cone,       // Rays fanned out by halfAngle either side of direction
+	Area        // Rays spread across width and fanned out by halfAngle, like a diffuse panel
+};
+
+// A light source kept as a handful of parameters rather than one RayData per ray.
+// The rays are generated straight into the ray buffers by the generate_emitter_rays kernel whenever the scene is retraced.
+struct Emitter
+{
+	EmitterType type = EmitterType::Point;
+	sf::Vector2f origin;
+	sf::Vector2f direction = { 1.0f, 0.0f };
+	float width = 100.0f;    // Collimated and area only, world units
+	float halfAngle = 0.25f; // Cone and area only, radians
+	unsigned int rayCount = 10;
+	bool whiteLight = true;
+	float wavelength = 0.0f; // nm, only used when whiteLight is false
+	sf::Color color = sf::Color::White;
+};
@@ -1,5 +1,10 @@
 #include "Entity.h"
 
+Entity::Entity(const std::string& tag, size_t ID)
+	:m_tag(tag), m_ID(ID) {}
+
+Entity::~Entity() = default;
+
 const std::string& Entity::getTag()
 {
 	return m_tag;
@@ -9,3 +14,8 @@ void Entity::setTag(const std::string& tag)
 {
 	m_tag = tag;
 }
+
+size_t Entity::getID() const
+{
+	return m_ID;
+}
\ No newline at end of file
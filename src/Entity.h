@@ -3,27 +3,33 @@
 #include "Components.h"
 #include "RayCollisionBuffers.h"
 #include <memory>
+#include "ComponentStore.h"
 class Entity
 {
 	std::string m_tag = "";
 	size_t m_ID = 0;
 public:
-	std::unique_ptr<CTransform> cTransform;
-	std::unique_ptr<CShape> cShape;
-	std::unique_ptr<CCustomShape> cCustomShape;
-	std::unique_ptr<CPrism> cPrism;
-	std::unique_ptr<CChildOf<Entity>> cChildOfEntity;
-	std::unique_ptr<CChildOf<RayData>> cChildOfRay;
-	std::unique_ptr<CMarker> cMarker;
+	// Each kind of component is packed into its own array, see ComponentStore.h
+	Component<CTransform> cTransform{ this };
+	Component<CShape> cShape{ this };
+	Component<CCustomShape> cCustomShape{ this };
+	Component<CPrism> cPrism{ this };
+	Component<CChildOf<Entity>> cChildOfEntity{ this };
+	Component<CChildOf<RayData>> cChildOfRay{ this };
+	Component<CMarker> cMarker{ this };
 
 	bool m_dead = false;
 	bool m_isMirror = false;
+	bool m_isDetector = false;
 
-	Entity(const std::string& tag, size_t ID)
-		:m_tag(tag), m_ID(ID) {}
+	Entity(const std::string& tag, size_t ID);
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
+	~Entity();
 
 	const std::string& getTag();
 	void setTag(const std::string& tag);
+	size_t getID() const; // Increases with creation order, which is also draw order
 
 };
 
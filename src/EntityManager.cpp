@@ -12,16 +12,80 @@ Entity& EntityManager::addEntity(const std::string& tag)
 
 void EntityManager::update()
 {
+    if (!m_entitiesToAdd.empty()) m_viewsDirty = true;
     for (auto& e : m_entitiesToAdd)
     {
+        // Components are attached by now so the bounds are right
+        m_pickGrid.update(e.get(), pickBounds(*e));
         m_entities.push_back(std::move(e));
     }
     m_entitiesToAdd.clear();
     auto toRemove = std::remove_if(m_entities.begin(), m_entities.end(), [](const std::unique_ptr<Entity>& e) {
         return e->m_dead;
         });
+    if (toRemove != m_entities.end()) m_viewsDirty = true;
+    for (auto it = toRemove; it != m_entities.end(); ++it)
+    {
+        m_pickGrid.remove(it->get());
+    }
     m_entities.erase(toRemove, m_entities.end());
+
+    if (m_viewsDirty) rebuildViews();
 }
+
+void EntityManager::rebuildViews()
+{
+    m_opticalEntities.clear();
+    for (const auto& entity : m_entities)
+    {
+        if (entity->cPrism || entity->m_isMirror || entity->m_isDetector) m_opticalEntities.push_back(entity.get());
+    }
+    m_viewsDirty = false;
+}
+
+sf::FloatRect EntityManager::pickBounds(Entity& entity)
+{
+    if (entity.cShape)
+    {
+        const sf::CircleShape& circle = entity.cShape->circle;
+        if (entity.getTag() == "Marker")
+        {
+            // Matches the enlarged marker hitbox used when picking
+            float radius = circle.getRadius() * 3;
+            return sf::FloatRect(circle.getPosition() - sf::Vector2f(radius, radius), sf::Vector2f(radius, radius) * 2.0f);
+        }
+        return circle.getGlobalBounds();
+    }
+    if (entity.cCustomShape)
+    {
+        return entity.cCustomShape->customShape->getGlobalBounds();
+    }
+    return sf::FloatRect();
+}
+
+void EntityManager::refreshBounds(Entity* entity)
+{
+    if (!entity || entity->m_dead) return;
+    m_pickGrid.update(entity, pickBounds(*entity));
+}
+
+const std::vector<Entity*>& EntityManager::queryPoint(const sf::Vector2f& point) const
+{
+    m_pickCandidates.clear();
+    m_pickGrid.query(point, m_pickCandidates);
+    // Entities killed this frame are still in the grid until update()
+    std::erase_if(m_pickCandidates, [](const Entity* e) { return e->m_dead; });
+    std::sort(m_pickCandidates.begin(), m_pickCandidates.end(), [](const Entity* a, const Entity* b) {
+        return a->getID() > b->getID();
+        });
+    return m_pickCandidates;
+}
+
+const std::vector<Entity*>& EntityManager::getOpticalEntities() const
+{
+    return m_opticalEntities;
+}
+
 const std::vector<std::unique_ptr<Entity>>& EntityManager::getEntities() const
 {
     return m_entities;
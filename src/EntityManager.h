@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Entity.h"
+#include "SpatialGrid.h"
 #include <vector>
 #include <memory>
 #include <string>
@@ -11,11 +12,38 @@ class EntityManager
     std::vector<std::unique_ptr<Entity>> m_entitiesToAdd;
     size_t m_totalEntities = 0;
 
+    // ---- Optical entities ----
+    // The ray collision buffers need these in entity order, which the component arrays don't keep, so they get their own list.
+    // Only rebuilt in update() when entities are added or removed, which means the components that make an entity optical
+    // have to be attached the same frame it's added.
+    std::vector<Entity*> m_opticalEntities;
+    bool m_viewsDirty = false;
+
+    // ---- Picking ----
+    SpatialGrid m_pickGrid;
+    mutable std::vector<Entity*> m_pickCandidates;
+
+    void rebuildViews();
+    static sf::FloatRect pickBounds(Entity& entity);
+
 public:
     Entity& addEntity(const std::string& tag);
     void update();
     const std::vector<std::unique_ptr<Entity>>& getEntities() const;
     std::vector<Entity*> getEntitiesWithTag(const std::string& tag) const;
 
+    // Prisms, mirrors and detectors, in the same order as getEntities() so the ray collision buffers line up
+    const std::vector<Entity*>& getOpticalEntities() const;
+
+    // Every T component packed together, for systems that only care about one kind of component to walk straight through.
+    // In no particular order, and still holds the components of entities that are dead but not removed yet or not added yet
+    template<typename T>
+    SlotMap<PackedComponent<T>>& components() { return componentStore<T>(); }
+
+    // Entities are put in the pick grid when added and taken out when removed, anything that moves or reshapes
+    // an entity after that has to call this or clicks will miss it
+    void refreshBounds(Entity* entity);
+    // Entities whose bounds contain the point, topmost (last drawn) first. Still needs an exact hit test
+    const std::vector<Entity*>& queryPoint(const sf::Vector2f& point) const;
 
 };
@@ -0,0 +1,162 @@
+#include "LaunchTuner.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+ulong LaunchConfig::globalRange(uint rayCount) const
+{
+	return (static_cast<ulong>(rayCount) + raysPerItem - 1) / raysPerItem;
+}
+
+LaunchTuner::LaunchTuner(std::string profilePath)
+	: m_profilePath(std::move(profilePath))
+{
+	load();
+}
+
+std::string LaunchTuner::profileKey(const Device& device, const std::string& kernel)
+{
+	// A specialised variant can have a different best config to the generic kernel, so it's tuned separately.
+	// The #define lines are joined with ';' so the key stays on one line of the profile file
+	std::string variant = device.get_variant();
+	std::replace(variant.begin(), variant.end(), '\n', ';');
+	return device.info.name + '\t' + device.info.driver_version + '\t' + kernel + '\t' + variant;
+}
+
+std::vector<LaunchConfig> LaunchTuner::makeCandidates(const Device& device)
+{
+	const ulong maxWorkgroupSize = device.info.cl_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+	std::vector<LaunchConfig> candidates;
+	// The default goes first so the very first launch is the same as it always was
+	candidates.push_back(LaunchConfig{});
+	for (uint workgroupSize : { 32u, 64u, 128u, 256u })
+	{
+		if (workgroupSize > maxWorkgroupSize) continue;
+		for (uint raysPerItem : { 1u, 2u, 4u })
+		{
+			for (uint chunkSize : { 0u, 1u << 16 })
+			{
+				LaunchConfig config{ workgroupSize, raysPerItem, chunkSize };
+				if (std::find(candidates.begin(), candidates.end(), config) == candidates.end())
+				{
+					candidates.push_back(config);
+				}
+			}
+		}
+	}
+	return candidates;
+}
+
+LaunchTuner::Profile& LaunchTuner::profileFor(const Device& device, const std::string& kernel)
+{
+	Profile& profile = m_profiles[profileKey(device, kernel)];
+	if (!profile.tuned && profile.candidates.empty())
+	{
+		profile.candidates = makeCandidates(device);
+	}
+	return profile;
+}
+
+LaunchConfig LaunchTuner::next(const Device& device, const std::string& kernel, uint rayCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Profile& profile = profileFor(device, kernel);
+	if (profile.tuned || rayCount < minTuningRays) return profile.best;
+	return profile.candidates[profile.costs.size()];
+}
+
+void LaunchTuner::report(const Device& device, const std::string& kernel, const LaunchConfig& config, uint rayCount, uint workPerRay, double seconds)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Profile& profile = profileFor(device, kernel);
+	if (profile.tuned || rayCount < minTuningRays || seconds <= 0.0) return;
+	// Only count the launch if it was the candidate being tried, not a small launch that used the current best
+	if (!(profile.candidates[profile.costs.size()] == config)) return;
+
+	profile.samples.push_back(seconds / (static_cast<double>(rayCount) * std::max(workPerRay, 1u)));
+	if (profile.samples.size() < samplesPerCandidate) return;
+	// Interference only ever makes a launch slower, so the fastest sample is the closest to what the candidate really costs
+	profile.costs.push_back(*std::min_element(profile.samples.begin(), profile.samples.end()));
+	profile.samples.clear();
+	if (profile.costs.size() < profile.candidates.size()) return;
+
+	size_t fastest = std::min_element(profile.costs.begin(), profile.costs.end()) - profile.costs.begin();
+	profile.best = profile.candidates[fastest];
+	profile.tuned = true;
+	std::cout << "Tuned " << kernel << " on " << device.info.name << ": work group size " << profile.best.workgroupSize
+		<< ", " << profile.best.raysPerItem << " rays per item, chunk size " << profile.best.chunkSize << '\n';
+	save();
+}
+
+bool LaunchTuner::isTuned(const Device& device, const std::string& kernel)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return profileFor(device, kernel).tuned;
+}
+
+LaunchConfig LaunchTuner::getBest(const Device& device, const std::string& kernel)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return profileFor(device, kernel).best;
+}
+
+void LaunchTuner::retune()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_profiles.clear();
+	std::error_code error;
+	std::filesystem::remove(m_profilePath, error);
+}
+
+// One tuned kernel per line: device name, driver version, kernel name, variant, work group size, rays per item, chunk size, tab separated
+void LaunchTuner::load()
+{
+	std::ifstream file(m_profilePath);
+	if (!file) return; // Nothing tuned on this machine yet
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, '\t'))
+		{
+			fields.push_back(field);
+		}
+		if (fields.size() != 7) continue; // Also skips profiles saved before variants were part of the key, they just get tuned again
+
+		try
+		{
+			LaunchConfig config;
+			config.workgroupSize = static_cast<uint>(std::stoul(fields[4]));
+			config.raysPerItem = static_cast<uint>(std::stoul(fields[5]));
+			config.chunkSize = static_cast<uint>(std::stoul(fields[6]));
+			if (config.workgroupSize == 0 || config.raysPerItem == 0) continue;
+
+			Profile& profile = m_profiles[fields[0] + '\t' + fields[1] + '\t' + fields[2] + '\t' + fields[3]];
+			profile.best = config;
+			profile.tuned = true;
+		}
+		catch (const std::exception&)
+		{
+			std::cerr << "Skipping bad line in " << m_profilePath << ": " << line << std::endl;
+		}
+	}
+}
+
+void LaunchTuner::save() const
+{
+	std::ofstream file(m_profilePath);
+	if (!file)
+	{
+		std::cerr << "Couldn't save launch profiles to " << m_profilePath << std::endl;
+		return;
+	}
+	for (const auto& [key, profile] : m_profiles)
+	{
+		if (!profile.tuned) continue;
+		file << key << '\t' << profile.best.workgroupSize << '\t' << profile.best.raysPerItem << '\t' << profile.best.chunkSize << '\n';
+	}
+}
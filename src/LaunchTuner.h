@@ -0,0 +1,62 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencl.hpp"
+
+// How a kernel is launched, the kernel has to loop over its rays with a stride of get_global_size(0) for raysPerItem to mean anything
+struct LaunchConfig
+{
+	uint workgroupSize = WORKGROUP_SIZE;
+	uint raysPerItem = 1;
+	uint chunkSize = 0; // Rays per enqueue, 0 launches everything at once
+
+	bool operator==(const LaunchConfig& other) const = default;
+
+	// Work items needed to cover rayCount rays
+	ulong globalRange(uint rayCount) const;
+};
+
+// Finds the fastest LaunchConfig for each kernel on each device by trying every candidate on a few of the real launches the first time the kernel runs,
+// rather than on a separate benchmark, so nothing gets traced twice. The winners are saved per device name, driver version and kernel variant
+// so later starts on the same machine go straight to the tuned config.
+class LaunchTuner
+{
+	struct Profile
+	{
+		std::vector<LaunchConfig> candidates;
+		std::vector<double> costs;   // Seconds per ray per unit of work, one per candidate tried so far
+		std::vector<double> samples; // The same for each launch of the candidate being tried, reduced to one cost once there are enough
+		LaunchConfig best;
+		bool tuned = false;
+	};
+
+	std::string m_profilePath;
+	std::map<std::string, Profile> m_profiles; // Keyed by device name, driver version, kernel name and the kernel variant's #defines
+	std::mutex m_mutex;                        // Every device traces from its own thread when the trace is split
+
+	// Launches smaller than this are mostly overhead so they'd skew the sweep, they just use the current best
+	static constexpr uint minTuningRays = 1u << 14;
+	// One launch can easily be slowed down by something else using the device, so each candidate is timed this many times
+	static constexpr size_t samplesPerCandidate = 3;
+
+	static std::string profileKey(const Device& device, const std::string& kernel);
+	static std::vector<LaunchConfig> makeCandidates(const Device& device);
+	Profile& profileFor(const Device& device, const std::string& kernel);
+	void load();
+	void save() const;
+
+public:
+	explicit LaunchTuner(std::string profilePath = "launch_profiles.txt");
+
+	// The config to launch kernel with next, a candidate still being tried or the tuned one
+	LaunchConfig next(const Device& device, const std::string& kernel, uint rayCount);
+	// Reports how long a launch from next() took, workPerRay is whatever the kernel's time scales with per ray (e.g. edge count)
+	void report(const Device& device, const std::string& kernel, const LaunchConfig& config, uint rayCount, uint workPerRay, double seconds);
+
+	bool isTuned(const Device& device, const std::string& kernel);
+	LaunchConfig getBest(const Device& device, const std::string& kernel);
+	// Forgets every tuned config, in memory and on disk, so they're all swept again
+	void retune();
+};
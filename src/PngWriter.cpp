@@ -0,0 +1,299 @@
+#include "PngWriter.h"
+#include <array>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	const std::uint8_t pngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	// Deflate length codes 257-285 and distance codes 0-29, see RFC 1951 section 3.2.5
+	const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int lengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const int distanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	const std::size_t windowSize = 32768;
+	const std::size_t maxMatchLength = 258;
+	const int hashBits = 15;
+
+	std::uint32_t crc32(const std::uint8_t* data, std::size_t size, std::uint32_t crc = 0xFFFFFFFFu)
+	{
+		static const std::array<std::uint32_t, 256> table = [] {
+			std::array<std::uint32_t, 256> t{};
+			for (std::uint32_t i = 0; i < 256; ++i)
+			{
+				std::uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+			return t;
+			}();
+		for (std::size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
+
+	std::uint32_t adler32(const std::uint8_t* data, std::size_t size)
+	{
+		const std::uint32_t base = 65521;
+		std::uint32_t a = 1, b = 0;
+		while (size > 0)
+		{
+			// 5552 is the most bytes we can sum before b can overflow 32 bits
+			std::size_t n = std::min<std::size_t>(size, 5552);
+			size -= n;
+			while (n--)
+			{
+				a += *data++;
+				b += a;
+			}
+			a %= base;
+			b %= base;
+		}
+		return (b << 16) | a;
+	}
+
+	// Same as zlib's adler32_combine, gives the checksum of A followed by B from the checksums of A and B
+	std::uint32_t adler32Combine(std::uint32_t adler1, std::uint32_t adler2, std::uint64_t length2)
+	{
+		const std::uint64_t base = 65521;
+		std::uint64_t rem = length2 % base;
+		std::uint64_t sum1 = adler1 & 0xFFFF;
+		std::uint64_t sum2 = (rem * sum1) % base;
+		sum1 += (adler2 & 0xFFFF) + base - 1;
+		sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + base - rem;
+		if (sum1 >= base) sum1 -= base;
+		if (sum1 >= base) sum1 -= base;
+		if (sum2 >= (base << 1)) sum2 -= (base << 1);
+		if (sum2 >= base) sum2 -= base;
+		return static_cast<std::uint32_t>(sum1 | (sum2 << 16));
+	}
+
+	void appendBigEndian(std::vector<std::uint8_t>& out, std::uint32_t value)
+	{
+		out.push_back(static_cast<std::uint8_t>(value >> 24));
+		out.push_back(static_cast<std::uint8_t>(value >> 16));
+		out.push_back(static_cast<std::uint8_t>(value >> 8));
+		out.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	// Deflate packs bits least significant first
+	class BitWriter
+	{
+		std::vector<std::uint8_t>& m_out;
+		std::uint32_t m_bitBuffer = 0;
+		int m_bitCount = 0;
+	public:
+		BitWriter(std::vector<std::uint8_t>& out) : m_out(out) {}
+
+		void writeBits(std::uint32_t value, int count)
+		{
+			m_bitBuffer |= value << m_bitCount;
+			m_bitCount += count;
+			while (m_bitCount >= 8)
+			{
+				m_out.push_back(static_cast<std::uint8_t>(m_bitBuffer & 0xFF));
+				m_bitBuffer >>= 8;
+				m_bitCount -= 8;
+			}
+		}
+
+		// Huffman codes are the odd one out and are packed most significant bit first
+		void writeCode(std::uint32_t code, int length)
+		{
+			std::uint32_t reversed = 0;
+			for (int i = 0; i < length; ++i)
+			{
+				reversed = (reversed << 1) | (code & 1);
+				code >>= 1;
+			}
+			writeBits(reversed, length);
+		}
+
+		// Fixed Huffman code for a literal/length symbol
+		void writeSymbol(int symbol)
+		{
+			if (symbol <= 143)      writeCode(0x30 + symbol, 8);
+			else if (symbol <= 255) writeCode(0x190 + (symbol - 144), 9);
+			else if (symbol <= 279) writeCode(symbol - 256, 7);
+			else                    writeCode(0xC0 + (symbol - 280), 8);
+		}
+
+		void writeMatch(int length, int distance)
+		{
+			int l = 28;
+			while (lengthBase[l] > length) l--;
+			writeSymbol(257 + l);
+			writeBits(length - lengthBase[l], lengthExtraBits[l]);
+
+			int d = 29;
+			while (distanceBase[d] > distance) d--;
+			writeCode(d, 5);
+			writeBits(distance - distanceBase[d], distanceExtraBits[d]);
+		}
+
+		void flushToByte()
+		{
+			if (m_bitCount > 0)
+				m_out.push_back(static_cast<std::uint8_t>(m_bitBuffer & 0xFF));
+			m_bitBuffer = 0;
+			m_bitCount = 0;
+		}
+	};
+}
+
+bool PngWriter::open(const std::string& filename, unsigned int width, unsigned int height)
+{
+	m_file.open(filename, std::ios::binary);
+	if (!m_file)
+	{
+		std::cerr << "PngWriter: could not open " << filename << " for writing\n";
+		return false;
+	}
+	m_width = width;
+	m_height = height;
+	m_rowsWritten = 0;
+	m_adler = 1;
+
+	m_file.write(reinterpret_cast<const char*>(pngSignature), sizeof(pngSignature));
+
+	std::vector<std::uint8_t> header;
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	header.push_back(8); // Bit depth
+	header.push_back(6); // Colour type RGBA
+	header.push_back(0); // Compression method deflate
+	header.push_back(0); // Filter method adaptive
+	header.push_back(0); // No interlacing
+	writeChunk("IHDR", header.data(), header.size());
+
+	// zlib header (deflate, 32K window, no preset dictionary), the compressed strips follow in their own IDAT chunks
+	const std::uint8_t zlibHeader[2] = { 0x78, 0x01 };
+	writeChunk("IDAT", zlibHeader, sizeof(zlibHeader));
+	return static_cast<bool>(m_file);
+}
+
+PngStrip PngWriter::compressRows(const std::uint8_t* pixels, unsigned int width, unsigned int rowCount)
+{
+	PngStrip strip;
+	strip.rowCount = rowCount;
+
+	// Every row starts with its filter type, screenshots are mostly flat colour so no filtering is needed
+	const std::size_t rowBytes = static_cast<std::size_t>(width) * 4;
+	std::vector<std::uint8_t> raw;
+	raw.reserve((rowBytes + 1) * rowCount);
+	for (unsigned int r = 0; r < rowCount; ++r)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels + r * rowBytes, pixels + (r + 1) * rowBytes);
+	}
+	strip.rawLength = raw.size();
+	strip.adler = adler32(raw.data(), raw.size());
+
+	BitWriter bits(strip.data);
+	bits.writeBits(0, 1); // Not the final block, that is written by close()
+	bits.writeBits(1, 2); // Fixed Huffman codes
+
+	// Greedy LZ77 which only remembers the most recent position for each 3 byte hash
+	std::vector<std::int64_t> head(std::size_t(1) << hashBits, -1);
+	auto hash = [&raw](std::size_t i) -> std::size_t {
+		std::uint32_t v = raw[i] | (raw[i + 1] << 8) | (raw[i + 2] << 16);
+		return (v * 2654435761u) >> (32 - hashBits);
+		};
+
+	const std::size_t n = raw.size();
+	std::size_t i = 0;
+	while (i < n)
+	{
+		std::size_t bestLength = 0;
+		std::size_t bestDistance = 0;
+		if (i + 2 < n)
+		{
+			std::size_t h = hash(i);
+			std::int64_t candidate = head[h];
+			head[h] = static_cast<std::int64_t>(i);
+			if (candidate >= 0 && i - static_cast<std::size_t>(candidate) <= windowSize)
+			{
+				std::size_t maxLength = std::min(maxMatchLength, n - i);
+				std::size_t length = 0;
+				while (length < maxLength && raw[candidate + length] == raw[i + length]) length++;
+				if (length >= 3)
+				{
+					bestLength = length;
+					bestDistance = i - static_cast<std::size_t>(candidate);
+				}
+			}
+		}
+
+		if (bestLength >= 3)
+		{
+			bits.writeMatch(static_cast<int>(bestLength), static_cast<int>(bestDistance));
+			// Still hash the bytes we skipped over so later matches can find them
+			for (std::size_t j = i + 1; j < i + bestLength && j + 2 < n; ++j)
+				head[hash(j)] = static_cast<std::int64_t>(j);
+			i += bestLength;
+		}
+		else
+		{
+			bits.writeSymbol(raw[i]);
+			i++;
+		}
+	}
+	bits.writeSymbol(256); // End of block
+
+	// Empty stored block to get back onto a byte boundary so strips can simply be concatenated
+	bits.writeBits(0, 1);
+	bits.writeBits(0, 2);
+	bits.flushToByte();
+	strip.data.insert(strip.data.end(), { 0x00, 0x00, 0xFF, 0xFF });
+	return strip;
+}
+
+bool PngWriter::appendStrip(const PngStrip& strip)
+{
+	if (m_rowsWritten + strip.rowCount > m_height)
+	{
+		std::cerr << "PngWriter: strip has more rows than the image\n";
+		return false;
+	}
+	writeChunk("IDAT", strip.data.data(), strip.data.size());
+	m_adler = adler32Combine(m_adler, strip.adler, strip.rawLength);
+	m_rowsWritten += strip.rowCount;
+	return static_cast<bool>(m_file);
+}
+
+bool PngWriter::close()
+{
+	// Final empty fixed Huffman block followed by the zlib checksum
+	std::vector<std::uint8_t> trailer = { 0x03, 0x00 };
+	appendBigEndian(trailer, m_adler);
+	writeChunk("IDAT", trailer.data(), trailer.size());
+	writeChunk("IEND", nullptr, 0);
+	m_file.close();
+
+	if (m_rowsWritten != m_height)
+	{
+		std::cerr << "PngWriter: only " << m_rowsWritten << " of " << m_height << " rows were written\n";
+		return false;
+	}
+	return !m_file.fail();
+}
+
+void PngWriter::writeChunk(const char* type, const std::uint8_t* data, std::size_t size)
+{
+	std::vector<std::uint8_t> length;
+	appendBigEndian(length, static_cast<std::uint32_t>(size));
+	m_file.write(reinterpret_cast<const char*>(length.data()), length.size());
+	m_file.write(type, 4);
+	if (size > 0)
+		m_file.write(reinterpret_cast<const char*>(data), size);
+
+	std::uint32_t crc = crc32(reinterpret_cast<const std::uint8_t*>(type), 4);
+	if (size > 0)
+		crc = crc32(data, size, crc);
+	std::vector<std::uint8_t> crcBytes;
+	appendBigEndian(crcBytes, crc ^ 0xFFFFFFFFu);
+	m_file.write(reinterpret_cast<const char*>(crcBytes.data()), crcBytes.size());
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A horizontal band of the image that has already been filtered and deflated.
+// Strips are byte aligned so they can be compressed on any thread and then appended in order.
+struct PngStrip
+{
+	std::vector<std::uint8_t> data;
+	std::uint32_t adler = 1;    // Adler-32 of the uncompressed (filtered) bytes
+	std::uint64_t rawLength = 0; // Number of uncompressed bytes, needed to combine checksums
+	unsigned int rowCount = 0;
+};
+
+// Writes an RGBA PNG a few rows at a time so the whole image never has to be in memory.
+// There is no zlib in this project so strips are compressed with a small fixed Huffman deflate encoder,
+// which does very well on screenshots as they are mostly black.
+class PngWriter
+{
+	std::ofstream m_file;
+	unsigned int m_width = 0;
+	unsigned int m_height = 0;
+	unsigned int m_rowsWritten = 0;
+	std::uint32_t m_adler = 1;
+
+	void writeChunk(const char* type, const std::uint8_t* data, std::size_t size);
+public:
+	// Opens the file and writes the signature and header, returns false if the file can't be written
+	bool open(const std::string& filename, unsigned int width, unsigned int height);
+
+	// Filters and compresses rowCount rows of tightly packed RGBA pixels, doesn't touch the file so is safe to call from worker threads
+	static PngStrip compressRows(const std::uint8_t* pixels, unsigned int width, unsigned int rowCount);
+
+	// Appends a compressed strip, strips must be appended top to bottom
+	bool appendStrip(const PngStrip& strip);
+
+	// Finishes the deflate stream and writes the end chunk, returns false if not every row was written
+	bool close();
+};
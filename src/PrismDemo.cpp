@@ -1,7 +1,7 @@
 #include "PrismDemo.h"
 
-PrismDemoShape::PrismDemoShape(const float width, const float alpha, const sf::Vector2f& position, RayData* incidentRay)
-	: m_width(width), m_alpha(alpha), m_incidentRay(incidentRay)
+PrismDemoShape::PrismDemoShape(const float width, const float alpha, const sf::Vector2f& position, SlotMap<RayData>& lightSources, SlotHandle incidentRay)
+	: m_width(width), m_alpha(alpha), m_lightSources(lightSources), m_incidentRay(incidentRay)
 {
 	setPosition(position);
 	regenerateGeometry();
@@ -89,12 +89,14 @@ void PrismDemoShape::createIncidentRay()
 	origin -= dir * 100.0f;
 	origin = getTransform().transformPoint(origin); // World coordinates
 
-	m_incidentRay->originX = origin.x;
-	m_incidentRay->originY = origin.y;
-	m_incidentRay->dirX = dir.x;
-	m_incidentRay->dirY = dir.y;
-	m_incidentRay->finished = false;
-	m_incidentRay->whiteLight = true;
+	RayData* incidentRay = m_lightSources.get(m_incidentRay);
+	if (!incidentRay) return;
+	incidentRay->originX = origin.x;
+	incidentRay->originY = origin.y;
+	incidentRay->dirX = dir.x;
+	incidentRay->dirY = dir.y;
+	incidentRay->finished = false;
+	incidentRay->whiteLight = true;
 }
 
 
@@ -108,7 +110,7 @@ float PrismDemoShape::getIncidentAngle() const
 	return m_incidentAngle;
 }
 
-RayData* PrismDemoShape::getIncidentRay() const
+SlotHandle PrismDemoShape::getIncidentRay() const
 {
 	return m_incidentRay;
 }
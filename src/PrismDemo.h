@@ -2,9 +2,11 @@
 #include "Util.h"
 #include "Entity.h"
 #include "RayCollisionBuffers.h"
+#include "SlotMap.h"
 class PrismDemoShape : public sf::Shape {
 public:
-    PrismDemoShape(const float width, const float alpha, const sf::Vector2f& position, RayData* incidentRay);
+    static constexpr ShapeKind shapeKind = ShapeKind::DemoPrism;
+    PrismDemoShape(const float width, const float alpha, const sf::Vector2f& position, SlotMap<RayData>& lightSources, SlotHandle incidentRay);
 	virtual std::size_t getPointCount() const override;
 	virtual sf::Vector2f getPoint(std::size_t index) const override;
 	void setAlpha(float alpha);
@@ -13,12 +15,13 @@ public:
 	float getAlpha() const;
 	float getAlphaIncrement() const; 
 	float getIncidentAngle() const;
-	RayData* getIncidentRay() const;
+	SlotHandle getIncidentRay() const;
 	void createIncidentRay();
 	void updateAlpha();
 private:
 	void regenerateGeometry(); 
-	RayData* m_incidentRay = nullptr;
+	SlotMap<RayData>& m_lightSources; // Where the incident ray lives, it's looked up through the handle every time as it can move
+	SlotHandle m_incidentRay;
 	std::vector<sf::Vector2f> m_points;
 	float m_width;
 	int m_alphaDir = 1; // 1 for increasing, -1 for decreasing
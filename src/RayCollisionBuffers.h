@@ -4,6 +4,8 @@
 #include <SFML/System.hpp>
 #include "opencl.hpp"
 #include <array>
+#include <algorithm>
+#include "RaySorter.h"
 
 struct RayData 
 {
@@ -14,11 +16,20 @@ struct RayData
     float refracIndex;
     sf::Color color;
     float wavelength;
+    float intensity = 1.0f; // Fraction of the source's energy this ray still carries, only used by detectors
+    std::uint32_t parent = UINT32_MAX; // RayTree node of the ray that spawned it, UINT32_MAX for light sources
+    std::uint32_t source = UINT32_MAX; // RayTree source ID, only needs to be right for rays without a parent
+    // Dispersion bundles, see Simulation::m_lazyDispersion
+    float wavelengthSpan = 0.0f; // Width of the band of wavelengths a bundle's centre ray stands in for, 0 for a single wavelength
+    std::uint32_t bundle = UINT32_MAX; // Which bundle of this generation the ray belongs to, UINT32_MAX for ordinary rays
+    std::uint8_t bundleRole = 0; // 0 the centre, 1 the probe at the short end of the band, 2 the probe at the long end
+    std::int32_t knownEdge = -1; // Edge the ray is known to hit first (rays split off white light), the kernel tests just that one. Only valid for the next trace
 };
 
 
 class RayCollisionBuffers {
     std::vector<RayData> raysToAdd;  // Temporary storage for new rays before committing
+    RaySorter sorter;
 
 public:
     static constexpr uint maxBufferSize = static_cast<const uint>(5e+5);
@@ -27,6 +38,7 @@ public:
     // ====================== ALL COUNTS POINT TO THE POSITION AFTER THE LAST ELEMENT IN THE BUFFER ==========================
     // Ray buffers
     uint currRayCount = 0; 
+    uint hostRayCount = 0; // Rays before this were written on the host and need uploading, any after were generated on the device by an emitter
     Memory<float> rayDirsX, rayDirsY;
 	Memory<float> reflectedRayDirsX, reflectedRayDirsY; // For reflected rays
     Memory<float> rayOriginsX, rayOriginsY;
@@ -44,7 +56,7 @@ public:
     Memory<float> createRayWithDirX, createRayWithDirY;
 
     // Special values
-    Memory<uint> screenBounds;
+    Memory<float> worldBounds; // Left, top, width, height of the box rays that miss everything stop at, in world units
     Memory<float> refracIndices;
     Memory<float> wavelengths;
 	Memory<float> transmissionCoefficients;
@@ -53,10 +65,32 @@ public:
     Memory<float> edgeB_X, edgeB_Y;              // Edge end points (x, y)
     Memory<int> edgeEntityIndices;               // Which entity each edge belongs to (index into prismEntities)
 	std::vector < sf::Color> rayColours; // For rendering purposes, not used in the kernel
+    std::vector<std::uint32_t> rayParents; // RayData::parent of each ray, only the host needs it
+    std::vector<std::uint32_t> raySources; // RayData::source of each ray, only the host needs it
+    std::vector<std::uint32_t> rayBundles; // RayData::bundle of each ray, only the host needs it
+    std::vector<std::uint8_t> rayBundleRoles; // RayData::bundleRole of each ray, only the host needs it
+    Memory<float> wavelengthSpans; // Detectors spread a bundle's energy over its band
+    Memory<int> knownEdges; // RayData::knownEdge, -1 to search every edge
+    Memory<int> hitEdges;   // Only for reading, the edge each white ray split at so its fan can skip the search
 
+    // Three A and three B coefficients per material, small enough for the kernel to read them from constant memory
+    static constexpr uint maxMaterials = 256;
     Memory<float> sellmeierCoefficientsA;
 	Memory<float> sellmeierCoefficientsB;
     Memory<int> entitySellmeierProfiles;
+    // n(wavelength) of every material sampled evenly over the white light spectrum, indexTableSize samples per material
+    static constexpr uint indexTableSize = 512;
+    Memory<float> refractiveIndexTable;
+
+    // Detector histograms, indexed [(detector * detectorPositionBins + positionBin) * detectorWavelengthBins + wavelengthBin]
+    // Energy is stored in 64-bit fixed point (detectorEnergyScale per unit) so the kernel can accumulate it with integer atomics,
+    // the scale is large enough that a split white light ray spread over every bin doesn't round down to nothing
+    static constexpr uint maxDetectors = 8;
+    static constexpr uint detectorPositionBins = 128;
+    static constexpr uint detectorWavelengthBins = 35;
+    static constexpr float detectorEnergyScale = 4294967296.0f; // 2^32
+    Memory<ulong> detectorHistogram;
+    Memory<float> rayIntensities;
 
 
     // Constructor to initialise buffers with the correct device
@@ -74,7 +108,7 @@ public:
         createRayWithDirX(device, maxBufferSize),
         createRayWithDirY(device, maxBufferSize),
         finishedProcessing(device, maxBufferSize),
-        screenBounds(device, 2),
+        worldBounds(device, 4),
         entityVerticesX(device, maxBufferSize),
         entityVerticesY(device, maxBufferSize),
         entityVertexCount(device, maxBufferSize),
@@ -89,9 +123,19 @@ public:
         edgeB_Y(device, maxBufferSize),
         edgeEntityIndices(device,maxBufferSize),
         rayColours(maxBufferSize),
-		sellmeierCoefficientsA(device, maxBufferSize),
-        sellmeierCoefficientsB(device, maxBufferSize),
-		entitySellmeierProfiles(device, maxBufferSize)
+        rayParents(maxBufferSize, UINT32_MAX),
+        raySources(maxBufferSize, UINT32_MAX),
+        rayBundles(maxBufferSize, UINT32_MAX),
+        rayBundleRoles(maxBufferSize, 0),
+        wavelengthSpans(device, maxBufferSize),
+        knownEdges(device, maxBufferSize),
+        hitEdges(device, maxBufferSize),
+		sellmeierCoefficientsA(device, maxMaterials * 3),
+        sellmeierCoefficientsB(device, maxMaterials * 3),
+		entitySellmeierProfiles(device, maxBufferSize),
+        refractiveIndexTable(device, maxMaterials * indexTableSize),
+        detectorHistogram(device, maxDetectors * detectorPositionBins * detectorWavelengthBins),
+        rayIntensities(device, maxBufferSize)
     {}
     
     void updateRayOrigin(float x, float y, uint index )
@@ -118,6 +162,7 @@ public:
 		whiteLight[currRayCount] = isWhiteLight;
 		refracIndices[currRayCount] = refractiveIndice;
 		rayColours[currRayCount] = rayColor; // Store the color for rendering
+		rayIntensities[currRayCount] = 1.0f;
 		currRayCount++;
     }
     void removeRay()
@@ -147,7 +192,7 @@ public:
 		createRayWithDirX.reset();
 		createRayWithDirY.reset();
 		finishedProcessing.reset();
-		screenBounds.reset();
+		worldBounds.reset();
 		entityVerticesX.reset();
 		entityVerticesY.reset();
 		entityVertexCount.reset();
@@ -161,34 +206,123 @@ public:
         raysToAdd.push_back(ray);
     }
 
-    void commitNewRays()
+    // Copies a contiguous block of rays straight into the buffers after the current ones
+    void appendRays(const RayData* rays, size_t count)
     {
-        for (const auto& ray : raysToAdd) 
+        if (currRayCount + count > maxBufferSize)
+        {
+            std::cerr << "Ray buffer is full! Cannot add more rays." << std::endl;
+            count = maxBufferSize - currRayCount;
+        }
+        for (size_t i = 0; i < count; ++i)
         {
-            if (currRayCount >= maxBufferSize)
-            {
-				std::cerr << "Ray buffer is full! Cannot add more rays." << std::endl;
-                break;
-            }
+            const RayData& ray = rays[i];
             rayOriginsX[currRayCount] = ray.originX;
             rayOriginsY[currRayCount] = ray.originY;
             rayDirsX[currRayCount] = ray.dirX;
             rayDirsY[currRayCount] = ray.dirY;
-            finishedProcessing[currRayCount] = ray.finished;
             whiteLight[currRayCount] = ray.whiteLight;
             refracIndices[currRayCount] = ray.refracIndex;
             rayColours[currRayCount] = ray.color;
             wavelengths[currRayCount] = ray.wavelength;
+            rayIntensities[currRayCount] = ray.intensity;
+            rayParents[currRayCount] = ray.parent;
+            raySources[currRayCount] = ray.source;
+            rayBundles[currRayCount] = ray.bundle;
+            rayBundleRoles[currRayCount] = ray.bundleRole;
+            wavelengthSpans[currRayCount] = ray.wavelengthSpan;
+            knownEdges[currRayCount] = ray.knownEdge;
             //Set all default data
             collisionPointsX[currRayCount] = -1.0f;
             collisionPointsY[currRayCount] = -1.0f;
             reflectedRayDirsX[currRayCount] = 0.0f; // Reset reflected ray direction
             reflectedRayDirsY[currRayCount] = 0.0f; // Reset reflected ray direction
             entityIndexHit[currRayCount] = 0;
-			finishedProcessing[currRayCount] = false; 
+            finishedProcessing[currRayCount] = false;
             currRayCount++;
         }
+        hostRayCount = currRayCount;
+    }
+
+    // Orders the rays waiting to be committed by where they start and which way they go, see RaySorter
+    void sortStagedRays()
+    {
+        sorter.sort(raysToAdd);
+    }
+
+    void commitNewRays()
+    {
+        appendRays(raysToAdd.data(), raysToAdd.size());
         raysToAdd.clear();
     }
 
+    // ---- Splitting a trace between devices ----
+    // These buffers hold one slice of another device's rays starting at index 0, so copy in the inputs of rays [offset, offset + count) of source and send them
+    void copyRayInputsFrom(const RayCollisionBuffers& source, uint offset, uint count)
+    {
+        std::copy_n(source.rayOriginsX.data() + offset, count, rayOriginsX.data());
+        std::copy_n(source.rayOriginsY.data() + offset, count, rayOriginsY.data());
+        std::copy_n(source.rayDirsX.data() + offset, count, rayDirsX.data());
+        std::copy_n(source.rayDirsY.data() + offset, count, rayDirsY.data());
+        std::copy_n(source.refracIndices.data() + offset, count, refracIndices.data());
+        std::copy_n(source.wavelengths.data() + offset, count, wavelengths.data());
+        std::copy_n(source.whiteLight.data() + offset, count, whiteLight.data());
+        std::copy_n(source.rayIntensities.data() + offset, count, rayIntensities.data());
+        std::copy_n(source.wavelengthSpans.data() + offset, count, wavelengthSpans.data());
+        std::copy_n(source.knownEdges.data() + offset, count, knownEdges.data());
+        currRayCount = count;
+        hostRayCount = count;
+    }
+
+    // Copies what the kernel wrote for this slice back into target's host buffers at offset, must already be read from the device
+    void copyRayResultsTo(RayCollisionBuffers& target, uint offset, uint count) const
+    {
+        std::copy_n(rayDirsX.data(), count, target.rayDirsX.data() + offset);
+        std::copy_n(rayDirsY.data(), count, target.rayDirsY.data() + offset);
+        std::copy_n(collisionPointsX.data(), count, target.collisionPointsX.data() + offset);
+        std::copy_n(collisionPointsY.data(), count, target.collisionPointsY.data() + offset);
+        std::copy_n(entityIndexHit.data(), count, target.entityIndexHit.data() + offset);
+        std::copy_n(transmissionCoefficients.data(), count, target.transmissionCoefficients.data() + offset);
+        std::copy_n(reflectedRayDirsX.data(), count, target.reflectedRayDirsX.data() + offset);
+        std::copy_n(reflectedRayDirsY.data(), count, target.reflectedRayDirsY.data() + offset);
+        std::copy_n(finishedProcessing.data(), count, target.finishedProcessing.data() + offset);
+        std::copy_n(hitEdges.data(), count, target.hitEdges.data() + offset);
+    }
+
+    // Mirrors the edges and world bounds already filled in on source's host side and sends them to this device
+    void copySceneFrom(const RayCollisionBuffers& source, uint edgeCount, uint entityCount)
+    {
+        std::copy_n(source.edgeA_X.data(), edgeCount, edgeA_X.data());
+        std::copy_n(source.edgeA_Y.data(), edgeCount, edgeA_Y.data());
+        std::copy_n(source.edgeB_X.data(), edgeCount, edgeB_X.data());
+        std::copy_n(source.edgeB_Y.data(), edgeCount, edgeB_Y.data());
+        std::copy_n(source.edgeEntityIndices.data(), edgeCount, edgeEntityIndices.data());
+        std::copy_n(source.entitySellmeierProfiles.data(), entityCount, entitySellmeierProfiles.data());
+        std::copy_n(source.worldBounds.data(), worldBounds.length(), worldBounds.data());
+        if (edgeCount > 0)
+        {
+            edgeA_X.write_to_device(0, edgeCount);
+            edgeA_Y.write_to_device(0, edgeCount);
+            edgeB_X.write_to_device(0, edgeCount);
+            edgeB_Y.write_to_device(0, edgeCount);
+            edgeEntityIndices.write_to_device(0, edgeCount);
+        }
+        if (entityCount > 0) entitySellmeierProfiles.write_to_device(0, entityCount);
+        worldBounds.write_to_device();
+    }
+
+    // Same for the materials, they only change when a profile is added so they're sent separately
+    void copyMaterialsFrom(const RayCollisionBuffers& source, uint materialCount)
+    {
+        std::copy_n(source.sellmeierCoefficientsA.data(), materialCount * 3, sellmeierCoefficientsA.data());
+        std::copy_n(source.sellmeierCoefficientsB.data(), materialCount * 3, sellmeierCoefficientsB.data());
+        std::copy_n(source.refractiveIndexTable.data(), materialCount * indexTableSize, refractiveIndexTable.data());
+        if (materialCount > 0)
+        {
+            sellmeierCoefficientsA.write_to_device(0, materialCount * 3);
+            sellmeierCoefficientsB.write_to_device(0, materialCount * 3);
+            refractiveIndexTable.write_to_device(0, materialCount * indexTableSize);
+        }
+    }
+
 };
\ No newline at end of file
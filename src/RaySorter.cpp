@@ -0,0 +1,93 @@
+#include <SFML/Graphics.hpp>
+#include "RaySorter.h"
+#include "RayCollisionBuffers.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Puts a zero bit between each of the low 16 bits so two of them can be interleaved into a Morton code
+std::uint32_t RaySorter::spreadBits(std::uint32_t value)
+{
+	value &= 0x0000ffff;
+	value = (value | (value << 8)) & 0x00ff00ff;
+	value = (value | (value << 4)) & 0x0f0f0f0f;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+// Which of 64 equal sectors the direction points into. Uses a pseudo angle (monotonic in the real one) to avoid an atan2 per ray
+std::uint32_t RaySorter::directionSector(float dirX, float dirY)
+{
+	float sum = std::abs(dirX) + std::abs(dirY);
+	if (sum == 0.0f) return 0;
+	float p = dirY / sum; // [-1, 1]
+	float angle = dirX >= 0.0f ? (p < 0.0f ? 4.0f + p : p) : 2.0f - p; // [0, 4) going round anticlockwise
+	return std::min(static_cast<std::uint32_t>(angle * 16.0f), 63u);
+}
+
+void RaySorter::sort(std::vector<RayData>& rays)
+{
+	const size_t count = rays.size();
+	if (count < 2) return;
+
+	// ---- Bounds of this generation's origins, the Morton grid is stretched over them ----
+	float minX = std::numeric_limits<float>::max(), minY = minX;
+	float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+	for (const RayData& ray : rays)
+	{
+		minX = std::min(minX, ray.originX);
+		minY = std::min(minY, ray.originY);
+		maxX = std::max(maxX, ray.originX);
+		maxY = std::max(maxY, ray.originY);
+	}
+	constexpr float gridMax = 8191.0f; // 13 bits per axis
+	const float scaleX = maxX > minX ? gridMax / (maxX - minX) : 0.0f;
+	const float scaleY = maxY > minY ? gridMax / (maxY - minY) : 0.0f;
+
+	// ---- Keys ----
+	m_keys.resize(count);
+	m_order.resize(count);
+	m_keysScratch.resize(count);
+	m_orderScratch.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const RayData& ray = rays[i];
+		std::uint32_t cellX = static_cast<std::uint32_t>((ray.originX - minX) * scaleX);
+		std::uint32_t cellY = static_cast<std::uint32_t>((ray.originY - minY) * scaleY);
+		std::uint32_t morton = spreadBits(cellX) | (spreadBits(cellY) << 1);
+		m_keys[i] = (morton << 6) | directionSector(ray.dirX, ray.dirY);
+		m_order[i] = static_cast<std::uint32_t>(i);
+	}
+
+	// ---- LSD radix sort, 8 bits a pass, keeps equal keys in their original order ----
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		size_t offsets[257] = {};
+		for (size_t i = 0; i < count; ++i)
+		{
+			offsets[((m_keys[i] >> shift) & 0xff) + 1]++;
+		}
+		if (offsets[((m_keys[0] >> shift) & 0xff) + 1] == count) continue; // Every key has the same digit, nothing to move
+		for (int digit = 0; digit < 256; ++digit)
+		{
+			offsets[digit + 1] += offsets[digit];
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t destination = offsets[(m_keys[i] >> shift) & 0xff]++;
+			m_keysScratch[destination] = m_keys[i];
+			m_orderScratch[destination] = m_order[i];
+		}
+		m_keys.swap(m_keysScratch);
+		m_order.swap(m_orderScratch);
+	}
+
+	// ---- Gather the rays into their new order ----
+	m_sorted.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_sorted[i] = rays[m_order[i]];
+	}
+	rays.swap(m_sorted);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct RayData;
+
+// Reorders a generation of rays so rays that start close together and head the same way sit next to each other in the buffers.
+// After a few bounces reflected and transmitted children are interleaved and dispersed wavelengths are scattered,
+// sorting them keeps neighbouring work items on the same edges and materials.
+// The key is a Morton code of the origin (13 bits per axis over the generation's bounds) with a 6 bit direction sector under it,
+// sorted with an LSD radix sort so the cost is linear in the number of rays.
+class RaySorter
+{
+	std::vector<std::uint32_t> m_keys, m_keysScratch;
+	std::vector<std::uint32_t> m_order, m_orderScratch;
+	std::vector<RayData> m_sorted;
+
+	static std::uint32_t spreadBits(std::uint32_t value);
+	static std::uint32_t directionSector(float dirX, float dirY);
+
+public:
+	void sort(std::vector<RayData>& rays);
+};
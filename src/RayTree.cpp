@@ -0,0 +1,221 @@
+#include "RayTree.h"
+#include "SegmentIndex.h"
+#include <algorithm>
+#include <unordered_set>
+
+void RayTree::clear()
+{
+	m_nodes.clear();
+	m_nodes.shrink_to_fit();
+	m_parents.clear();
+	m_parents.shrink_to_fit();
+	m_scene.clear();
+	m_sources.clear();
+	m_sourceKeys.clear();
+	m_sourceIds.clear();
+	m_recording = false;
+	m_hasScene = false;
+}
+
+void RayTree::start(std::uint64_t inputs, Sources sources)
+{
+	m_nodes.clear();
+	m_parents.clear();
+	m_scene.clear();
+	m_sources = std::move(sources);
+	m_sourceKeys.clear();
+	m_sourceIds.clear();
+	m_inputs = inputs;
+	m_recording = true;
+	m_hasScene = false;
+}
+
+// The top bit says which SlotMap, then the generation and index so a reused slot is a different source
+RayTree::SourceKey RayTree::lightSourceKey(SlotHandle handle)
+{
+	return (static_cast<SourceKey>(handle.generation & 0x7fffffff) << 32) | handle.index;
+}
+
+RayTree::SourceKey RayTree::emitterKey(SlotHandle handle)
+{
+	return lightSourceKey(handle) | (1ull << 63);
+}
+
+bool RayTree::isEmitter(SourceKey key)
+{
+	return (key >> 63) != 0;
+}
+
+SlotHandle RayTree::sourceHandle(SourceKey key)
+{
+	return SlotHandle{ static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(key >> 32) & 0x7fffffff };
+}
+
+std::uint32_t RayTree::sourceId(SourceKey key)
+{
+	auto [it, inserted] = m_sourceIds.try_emplace(key, static_cast<std::uint32_t>(m_sourceKeys.size()));
+	if (inserted) m_sourceKeys.push_back(key);
+	return it->second;
+}
+
+void RayTree::setScene(Scene scene)
+{
+	m_scene = std::move(scene);
+	m_hasScene = true;
+}
+
+std::uint32_t RayTree::add(const Node& node, std::uint32_t parent)
+{
+	if (!m_recording) return noParent;
+	if (m_nodes.size() >= maxNodes)
+	{
+		clear();
+		return noParent;
+	}
+	m_nodes.push_back(node);
+	// Only the roots carry their source in the ray, everything else inherits it
+	m_nodes.back().source = parent == noParent ? node.ray.source : m_nodes[parent].source;
+	m_parents.push_back(parent);
+	return static_cast<std::uint32_t>(m_nodes.size() - 1);
+}
+
+bool RayTree::invalidate(const Scene& scene, std::uint64_t inputs, const Sources& sources, std::vector<RayData>& retrace, std::vector<SourceKey>& emit)
+{
+	if (!m_recording || !m_hasScene || inputs != m_inputs) return false;
+
+	// ---- Which sources changed: their rays all go and they're emitted again ----
+	std::vector<char> staleSource(m_sourceKeys.size(), 0);
+	for (size_t id = 0; id < m_sourceKeys.size(); ++id)
+	{
+		auto before = m_sources.find(m_sourceKeys[id]);
+		auto now = sources.find(m_sourceKeys[id]);
+		staleSource[id] = before == m_sources.end() || now == sources.end() || before->second != now->second;
+	}
+	for (const auto& [key, signature] : sources)
+	{
+		auto before = m_sources.find(key);
+		if (before == m_sources.end() || before->second != signature) emit.push_back(key);
+	}
+
+	// ---- What changed: removed and edited entities could have been hit, any entity could now be in the way ----
+	std::unordered_set<size_t> changed;
+	std::vector<sf::FloatRect> regions;
+	for (const auto& [id, before] : m_scene)
+	{
+		auto now = scene.find(id);
+		if (now != scene.end() && now->second.signature == before.signature) continue;
+		changed.insert(id);
+		regions.push_back(before.bounds);
+		if (now != scene.end()) regions.push_back(now->second.bounds);
+	}
+	for (const auto& [id, now] : scene)
+	{
+		if (m_scene.find(id) == m_scene.end()) regions.push_back(now.bounds);
+	}
+	for (sf::FloatRect& region : regions)
+	{
+		// Rays start a direction's length past where they hit, so pad by a bit more than that
+		region.position -= sf::Vector2f(2.0f, 2.0f);
+		region.size += sf::Vector2f(4.0f, 4.0f);
+	}
+
+	// ---- Mark, parents always come before their children so one pass in order is enough ----
+	std::vector<char> dead(m_nodes.size(), 0);
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+	{
+		const Node& node = m_nodes[i];
+		bool killed = m_parents[i] != noParent && dead[m_parents[i]];
+		if (!killed && node.source < staleSource.size()) killed = staleSource[node.source];
+		if (!killed && node.hitEntity != noEntity) killed = changed.count(node.hitEntity) > 0;
+		for (size_t r = 0; r < regions.size() && !killed; ++r)
+		{
+			killed = SegmentIndex::segmentTouches(node.start, node.end, regions[r]);
+		}
+		// A detector has already added this ray to its histogram and there's no taking it back
+		if (killed && node.hitDetector) return false;
+		dead[i] = killed;
+	}
+
+	// ---- Sweep, keep the survivors in order and hand back the root of each dead sub-tree ----
+	std::vector<std::uint32_t> remap(m_nodes.size(), noParent);
+	std::uint32_t kept = 0;
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+	{
+		const std::uint32_t parent = m_parents[i];
+		const std::uint32_t newParent = parent == noParent ? noParent : remap[parent];
+		if (dead[i])
+		{
+			const bool sourceEmittedAgain = parent == noParent && m_nodes[i].source < staleSource.size() && staleSource[m_nodes[i].source];
+			if (!sourceEmittedAgain && (parent == noParent || !dead[parent]))
+			{
+				RayData ray = m_nodes[i].ray;
+				ray.parent = newParent;
+				retrace.push_back(ray);
+			}
+			continue;
+		}
+		remap[i] = kept;
+		m_nodes[kept] = m_nodes[i];
+		m_parents[kept] = newParent;
+		kept++;
+	}
+	m_nodes.resize(kept);
+	m_parents.resize(kept);
+	m_scene = scene;
+	m_sources = sources;
+	return true;
+}
+
+void RayTree::appendSegments(sf::VertexArray& rays) const
+{
+	for (const Node& node : m_nodes)
+	{
+		rays.append(sf::Vertex{ node.start, node.ray.color });
+		rays.append(sf::Vertex{ node.end, node.ray.color });
+	}
+}
+
+// FNV-1a, only ever compared against the same build so it doesn't need to be anything clever
+void RayTree::hash(std::uint64_t& seed, const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		seed ^= bytes[i];
+		seed *= 1099511628211ull;
+	}
+}
+
+void RayTree::hash(std::uint64_t& seed, const sf::Color& colour)
+{
+	hash(seed, colour.toInteger());
+}
+
+void RayTree::hash(std::uint64_t& seed, const RayData& ray)
+{
+	hash(seed, ray.originX);
+	hash(seed, ray.originY);
+	hash(seed, ray.dirX);
+	hash(seed, ray.dirY);
+	hash(seed, ray.whiteLight);
+	hash(seed, ray.refracIndex);
+	hash(seed, ray.color);
+	hash(seed, ray.wavelength);
+	hash(seed, ray.intensity);
+}
+
+void RayTree::hash(std::uint64_t& seed, const Emitter& emitter)
+{
+	hash(seed, emitter.type);
+	hash(seed, emitter.origin.x);
+	hash(seed, emitter.origin.y);
+	hash(seed, emitter.direction.x);
+	hash(seed, emitter.direction.y);
+	hash(seed, emitter.width);
+	hash(seed, emitter.halfAngle);
+	hash(seed, emitter.rayCount);
+	hash(seed, emitter.whiteLight);
+	hash(seed, emitter.wavelength);
+	hash(seed, emitter.color);
+}
+
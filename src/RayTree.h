@@ -0,0 +1,90 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "RayCollisionBuffers.h"
+#include "SlotMap.h"
+#include "Emitter.h"
+
+// Every segment of the last trace kept as a tree, each traced ray remembers which ray spawned it and which light source it came from.
+// When an entity moves only the rays that hit it or cross where it was (or now is) are thrown away along with everything they spawned,
+// the roots of those sub-trees are traced again and the rest of the rays are kept as they were.
+// When a light source or emitter changes only its own rays are thrown away and it is emitted again on its own.
+class RayTree
+{
+public:
+	static constexpr std::uint32_t noParent = UINT32_MAX;
+	static constexpr std::uint32_t noSource = UINT32_MAX;
+	static constexpr size_t noEntity = SIZE_MAX;
+	static constexpr size_t maxNodes = 1 << 22; // Past this the tree is dropped and every change is a full re-trace again
+
+	struct Node
+	{
+		RayData ray;                 // The ray as it was launched, enough to trace it again
+		sf::Vector2f start, end;     // The segment that was drawn
+		size_t hitEntity = noEntity; // ID of the entity it stopped at, noEntity if it left the screen
+		bool hitDetector = false;
+		std::uint32_t source = noSource; // Filled in by add()
+	};
+
+	// An entity as the kernel saw it: its bounds and a hash of its edges and material
+	struct EntityState
+	{
+		sf::FloatRect bounds;
+		std::uint64_t signature = hashSeed;
+	};
+	using Scene = std::unordered_map<size_t, EntityState>; // Keyed by entity ID
+
+	// A light source or emitter by its handle, with a bit to tell which SlotMap it's in
+	using SourceKey = std::uint64_t;
+	using Sources = std::unordered_map<SourceKey, std::uint64_t>; // Hash of each source as it was traced
+	static SourceKey lightSourceKey(SlotHandle handle);
+	static SourceKey emitterKey(SlotHandle handle);
+	static bool isEmitter(SourceKey key);
+	static SlotHandle sourceHandle(SourceKey key);
+
+	// Drops the tree, the next change is a full re-trace
+	void clear();
+	// Starts recording a new trace from scratch, inputs is a hash of everything apart from the entities and sources that the trace depends on
+	void start(std::uint64_t inputs, Sources sources);
+	// Small number stored in RayData::source for the root rays of a source, their children inherit it through add()
+	std::uint32_t sourceId(SourceKey key);
+	bool isRecording() const { return m_recording; }
+	bool hasScene() const { return m_hasScene; }
+	void setScene(Scene scene);
+
+	// Adds a traced ray, returns the index its children should use as their parent (noParent if the tree has grown too big)
+	std::uint32_t add(const Node& node, std::uint32_t parent);
+
+	// Throws away every node the difference between the traced scene and scene could have changed, and every ray of a source that changed.
+	// The first ray of each thrown away sub-tree is put in retrace with its parent set to where that parent now is,
+	// sources that are new or changed are put in emit and have to be emitted again from scratch.
+	// Returns false if this can't be done and everything has to be traced again (the inputs changed, a detector already counted a thrown away ray)
+	bool invalidate(const Scene& scene, std::uint64_t inputs, const Sources& sources, std::vector<RayData>& retrace, std::vector<SourceKey>& emit);
+
+	// Puts every kept segment back into rays
+	void appendSegments(sf::VertexArray& rays) const;
+	size_t size() const { return m_nodes.size(); }
+
+	// ---- Hashing the trace inputs ----
+	static constexpr std::uint64_t hashSeed = 14695981039346656037ull;
+	static void hash(std::uint64_t& seed, const void* data, size_t size);
+	template <typename T>
+	static void hash(std::uint64_t& seed, const T& value) { hash(seed, &value, sizeof(T)); }
+	static void hash(std::uint64_t& seed, const sf::Color& colour);
+	static void hash(std::uint64_t& seed, const RayData& ray); // Field by field, the struct has padding
+	static void hash(std::uint64_t& seed, const Emitter& emitter);
+
+private:
+	std::vector<Node> m_nodes;
+	std::vector<std::uint32_t> m_parents; // m_parents[i] is always before i, so one pass in order visits parents first
+	Scene m_scene;
+	Sources m_sources;
+	std::vector<SourceKey> m_sourceKeys; // Indexed by source ID
+	std::unordered_map<SourceKey, std::uint32_t> m_sourceIds;
+
+	std::uint64_t m_inputs = 0;
+	bool m_recording = false;
+	bool m_hasScene = false;
+};
@@ -0,0 +1,229 @@
+#include "SegmentIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+int SegmentIndex::column(float x) const
+{
+	return std::clamp(static_cast<int>(std::floor((x - m_gridBounds.position.x) / m_cellSize)), 0, m_columns - 1);
+}
+
+int SegmentIndex::row(float y) const
+{
+	return std::clamp(static_cast<int>(std::floor((y - m_gridBounds.position.y) / m_cellSize)), 0, m_rows - 1);
+}
+
+bool SegmentIndex::insideGrid(sf::Vector2f point) const
+{
+	// Inclusive of the far sides unlike FloatRect::contains, the starts that set the grid's bounds lie on them
+	return point.x >= m_gridBounds.position.x && point.x <= m_gridBounds.position.x + m_gridBounds.size.x &&
+		point.y >= m_gridBounds.position.y && point.y <= m_gridBounds.position.y + m_gridBounds.size.y;
+}
+
+void SegmentIndex::clear()
+{
+	m_cellStart.clear();
+	m_cellSegments.clear();
+	m_oversized.clear();
+	m_leaving.clear();
+	m_stamps.clear();
+	m_found.clear();
+	m_segmentCount = 0;
+	m_columns = m_rows = 0;
+}
+
+void SegmentIndex::build(const sf::VertexArray& lines)
+{
+	clear();
+	m_segmentCount = lines.getVertexCount() / 2;
+	if (m_segmentCount == 0) return;
+
+	// ---- Bounds of everything for the nothing to cull check, and of the starts for the grid ----
+	// Segments start at an emitter or a hit so the starts stay in the scene, only the ends fly off to the world bounds
+	sf::Vector2f minPoint = lines[0].position, maxPoint = lines[0].position;
+	sf::Vector2f minStart = lines[0].position, maxStart = lines[0].position;
+	for (size_t i = 1; i < m_segmentCount * 2; ++i)
+	{
+		const sf::Vector2f& point = lines[i].position;
+		minPoint = { std::min(minPoint.x, point.x), std::min(minPoint.y, point.y) };
+		maxPoint = { std::max(maxPoint.x, point.x), std::max(maxPoint.y, point.y) };
+		if (i % 2 == 0)
+		{
+			minStart = { std::min(minStart.x, point.x), std::min(minStart.y, point.y) };
+			maxStart = { std::max(maxStart.x, point.x), std::max(maxStart.y, point.y) };
+		}
+	}
+	m_bounds = sf::FloatRect(minPoint, maxPoint - minPoint);
+	m_gridBounds = sf::FloatRect(minStart, maxStart - minStart);
+
+	// ---- Grid over the starts, roughly four segments a cell ----
+	const float extent = std::max({ m_gridBounds.size.x, m_gridBounds.size.y, 1.0f });
+	const int cellsPerAxis = std::clamp(static_cast<int>(std::ceil(std::sqrt(m_segmentCount / 4.0))), 1, maxCellsPerAxis);
+	m_cellSize = extent / cellsPerAxis;
+	m_columns = std::max(1, static_cast<int>(std::ceil(m_gridBounds.size.x / m_cellSize)));
+	m_rows = std::max(1, static_cast<int>(std::ceil(m_gridBounds.size.y / m_cellSize)));
+
+	// Walks the cells crossed by the part of a segment inside the grid, one cell at a time so a long diagonal doesn't fill its whole bounding box.
+	// Returns how many cells that is, without visiting them if it's more than maxCellsPerSegment, or 0 if the segment misses the grid
+	constexpr float never = std::numeric_limits<float>::infinity();
+	auto forEachCell = [&](size_t segment, auto&& visit) -> int {
+		const sf::Vector2f& a = lines[segment * 2].position;
+		const sf::Vector2f& b = lines[segment * 2 + 1].position;
+		float t0 = 0.0f, t1 = 1.0f;
+		if (!clipSegment(a, b, m_gridBounds, t0, t1)) return 0;
+
+		const sf::Vector2f d = b - a;
+		const sf::Vector2f p0 = a + d * t0, p1 = a + d * t1;
+		int c = column(p0.x), r = row(p0.y);
+		const int cEnd = column(p1.x), rEnd = row(p1.y);
+		const int steps = std::abs(cEnd - c) + std::abs(rEnd - r);
+		if (steps + 1 > maxCellsPerSegment) return steps + 1;
+
+		// t along ab of the next column and row boundary the segment crosses, and how far t moves between boundaries
+		const int stepC = cEnd > c ? 1 : -1, stepR = rEnd > r ? 1 : -1;
+		const float deltaX = d.x != 0.0f ? m_cellSize / std::abs(d.x) : never;
+		const float deltaY = d.y != 0.0f ? m_cellSize / std::abs(d.y) : never;
+		float nextX = d.x != 0.0f ? (m_gridBounds.position.x + (c + (stepC > 0 ? 1 : 0)) * m_cellSize - a.x) / d.x : never;
+		float nextY = d.y != 0.0f ? (m_gridBounds.position.y + (r + (stepR > 0 ? 1 : 0)) * m_cellSize - a.y) / d.y : never;
+
+		visit(r * m_columns + c);
+		for (int i = 0; i < steps; ++i)
+		{
+			// Never step past the end cell on either axis, rounding could otherwise send the walk around it
+			if (r == rEnd || (c != cEnd && nextX < nextY))
+			{
+				c += stepC;
+				nextX += deltaX;
+			}
+			else
+			{
+				r += stepR;
+				nextY += deltaY;
+			}
+			visit(r * m_columns + c);
+		}
+		return steps + 1;
+		};
+
+	// ---- Count, offsets, then fill ----
+	m_cellStart.assign(static_cast<size_t>(m_columns) * m_rows + 1, 0);
+	for (size_t i = 0; i < m_segmentCount; ++i)
+	{
+		const int cells = forEachCell(i, [&](int cell) { m_cellStart[cell + 1]++; });
+		if (cells > maxCellsPerSegment)
+		{
+			m_oversized.push_back(static_cast<std::uint32_t>(i));
+		}
+		else if (cells == 0 || !insideGrid(lines[i * 2].position) || !insideGrid(lines[i * 2 + 1].position))
+		{
+			m_leaving.push_back(static_cast<std::uint32_t>(i));
+		}
+	}
+	for (size_t cell = 1; cell < m_cellStart.size(); ++cell)
+	{
+		m_cellStart[cell] += m_cellStart[cell - 1];
+	}
+	m_cellSegments.resize(m_cellStart.back());
+	std::vector<std::uint32_t> cursor(m_cellStart.begin(), m_cellStart.end() - 1);
+	for (size_t i = 0; i < m_segmentCount; ++i)
+	{
+		forEachCell(i, [&](int cell) { m_cellSegments[cursor[cell]++] = static_cast<std::uint32_t>(i); });
+	}
+
+	m_stamps.assign(m_segmentCount, 0);
+	m_queryStamp = 0;
+}
+
+const sf::VertexArray& SegmentIndex::query(const sf::VertexArray& lines, const sf::FloatRect& rect, sf::VertexArray& out)
+{
+	// The whole trace is in view, nothing to cull
+	if (m_segmentCount == 0 ||
+		(rect.position.x <= m_bounds.position.x && rect.position.y <= m_bounds.position.y &&
+		 rect.position.x + rect.size.x >= m_bounds.position.x + m_bounds.size.x &&
+		 rect.position.y + rect.size.y >= m_bounds.position.y + m_bounds.size.y))
+	{
+		return lines;
+	}
+
+	if (++m_queryStamp == 0)
+	{
+		std::fill(m_stamps.begin(), m_stamps.end(), 0);
+		m_queryStamp = 1;
+	}
+	m_found.clear();
+
+	auto test = [&](std::uint32_t segment) {
+		if (m_stamps[segment] == m_queryStamp) return;
+		m_stamps[segment] = m_queryStamp;
+		if (segmentTouches(lines[segment * 2].position, lines[segment * 2 + 1].position, rect)) m_found.push_back(segment);
+		};
+
+	// ---- Cells under the rectangle, if it overlaps the grid at all ----
+	const float gridRight = m_gridBounds.position.x + m_gridBounds.size.x, gridBottom = m_gridBounds.position.y + m_gridBounds.size.y;
+	const float rectRight = rect.position.x + rect.size.x, rectBottom = rect.position.y + rect.size.y;
+	if (rect.position.x <= gridRight && rectRight >= m_gridBounds.position.x && rect.position.y <= gridBottom && rectBottom >= m_gridBounds.position.y)
+	{
+		const int c0 = column(rect.position.x), c1 = column(rectRight);
+		const int r0 = row(rect.position.y), r1 = row(rectBottom);
+		for (int r = r0; r <= r1; ++r)
+		{
+			for (int c = c0; c <= c1; ++c)
+			{
+				const int cell = r * m_columns + c;
+				for (std::uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i)
+				{
+					test(m_cellSegments[i]);
+				}
+			}
+		}
+	}
+	for (std::uint32_t segment : m_oversized)
+	{
+		test(segment);
+	}
+	// The cells only hold the parts of segments inside the grid, anything in view past its edges can only come from these
+	if (rect.position.x < m_gridBounds.position.x || rect.position.y < m_gridBounds.position.y || rectRight > gridRight || rectBottom > gridBottom)
+	{
+		for (std::uint32_t segment : m_leaving)
+		{
+			test(segment);
+		}
+	}
+
+	// Keep the traced order so overlapping rays blend the same as when everything is drawn
+	std::sort(m_found.begin(), m_found.end());
+	out.setPrimitiveType(sf::PrimitiveType::Lines);
+	out.resize(m_found.size() * 2);
+	for (size_t i = 0; i < m_found.size(); ++i)
+	{
+		out[i * 2] = lines[m_found[i] * 2];
+		out[i * 2 + 1] = lines[m_found[i] * 2 + 1];
+	}
+	return out;
+}
+
+bool SegmentIndex::clipSegment(sf::Vector2f a, sf::Vector2f b, const sf::FloatRect& rect, float& t0, float& t1)
+{
+	const sf::Vector2f d = b - a;
+	const float p[4] = { -d.x, d.x, -d.y, d.y };
+	const float q[4] = { a.x - rect.position.x, rect.position.x + rect.size.x - a.x, a.y - rect.position.y, rect.position.y + rect.size.y - a.y };
+	for (int i = 0; i < 4; ++i)
+	{
+		if (p[i] == 0.0f)
+		{
+			if (q[i] < 0.0f) return false; // Parallel to this side and outside it
+			continue;
+		}
+		const float t = q[i] / p[i];
+		if (p[i] < 0.0f) t0 = std::max(t0, t);
+		else t1 = std::min(t1, t);
+		if (t0 > t1) return false;
+	}
+	return true;
+}
+
+bool SegmentIndex::segmentTouches(sf::Vector2f a, sf::Vector2f b, const sf::FloatRect& rect)
+{
+	float t0 = 0.0f, t1 = 1.0f;
+	return clipSegment(a, b, rect, t0, t1);
+}
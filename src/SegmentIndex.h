@@ -0,0 +1,50 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over the line segments of a finished trace so only the ones in view get drawn.
+// Built once per trace and never updated, every cell's segments sit in one array with an offset per cell.
+// The grid only covers where segments start, i.e. the scene, so the rays that run off to the world bounds don't stretch every cell.
+// Those are clipped to the grid and also kept in a list that's only tested when the view reaches outside the grid.
+// Segments crossing more than maxCellsPerSegment cells go in one list every query tests instead.
+class SegmentIndex
+{
+	sf::FloatRect m_bounds;     // Around every segment
+	sf::FloatRect m_gridBounds; // Around every segment's start
+	float m_cellSize = 1.0f;
+	int m_columns = 0, m_rows = 0;
+	std::vector<std::uint32_t> m_cellStart;    // m_columns * m_rows + 1 offsets into m_cellSegments
+	std::vector<std::uint32_t> m_cellSegments; // Segment indices, the first vertex of segment i is 2 * i
+	std::vector<std::uint32_t> m_oversized;
+	std::vector<std::uint32_t> m_leaving;      // Segments with some part outside the grid, they're in the cells they cross as well
+	size_t m_segmentCount = 0;
+
+	// Stops a segment in several cells being returned more than once per query
+	std::vector<std::uint32_t> m_stamps;
+	std::uint32_t m_queryStamp = 0;
+	std::vector<std::uint32_t> m_found;
+
+	static constexpr int maxCellsPerSegment = 256;
+	static constexpr int maxCellsPerAxis = 1024;
+
+	int column(float x) const;
+	int row(float y) const;
+	bool insideGrid(sf::Vector2f point) const;
+
+	// Liang-Barsky, narrows [t0, t1] to the part of the segment ab inside rect, false if none of it is
+	static bool clipSegment(sf::Vector2f a, sf::Vector2f b, const sf::FloatRect& rect, float& t0, float& t1);
+
+public:
+	// Indexes every segment of a Lines vertex array
+	void build(const sf::VertexArray& lines);
+	void clear();
+	size_t size() const { return m_segmentCount; }
+
+	// Puts every segment of lines (the array it was built from) that touches rect into out, in the order they were traced.
+	// Returns out, or lines itself if all of it is inside rect
+	const sf::VertexArray& query(const sf::VertexArray& lines, const sf::FloatRect& rect, sf::VertexArray& out);
+
+	// True if any part of the segment ab is inside rect
+	static bool segmentTouches(sf::Vector2f a, sf::Vector2f b, const sf::FloatRect& rect);
+};
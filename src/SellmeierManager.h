@@ -7,6 +7,7 @@
 class SellmeierManager
 {
 	std::vector<std::unique_ptr<Sellmeier>> sellmeierProfiles;
+	unsigned int version = 0; // Goes up every time the profiles change, so the GPU copy of them is only updated when it has to be
 public:
 	// Constructor
 	SellmeierManager() = default;
@@ -15,6 +16,11 @@ public:
 	void addProfile(const std::vector<double>& aCoefficients, const std::vector<double>& bCoefficients, std::string tag)
 	{
 		sellmeierProfiles.push_back(std::make_unique<Sellmeier>(aCoefficients, bCoefficients, tag));
+		version++;
+	}
+	unsigned int getVersion() const
+	{
+		return version;
 	}
 	Sellmeier* getSellmeier(const std::string& tag)
 	{
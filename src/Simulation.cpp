@@ -8,6 +8,14 @@
 #include <algorithm>
 #include "Components.h"
 #include "SellmeierManager.h"
+#include "PngWriter.h"
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <thread>
+#include <cstdio>
 
 void Simulation::init()
 {
@@ -56,6 +64,7 @@ void Simulation::init()
 		float wavelength = m_startWavelength + i * step;
 		sf::Color color = wavelengthToRGB(wavelength);
 		wavelengthColors[wavelength] = color;
+		m_spectrum.emplace_back(wavelength, color);
 	}
 
 	// ╔═════════════════════════════════════════════════╗
@@ -106,6 +115,7 @@ void Simulation::run()
 		sUpdateWavelengthCreation();
 		sUpdateAlpha();
 		sUserInput();
+		sUpdateTessellation();
 		sHandleStateChange();
 		sCollisionv2();
 		ImGui::SFML::Update(m_window, m_deltaClock.restart());
@@ -120,32 +130,332 @@ void Simulation::sHandleStateChange()
 {
 	if (m_stateChange)
 	{
-		// ---- Reset buffers and clear all rays ----
-		allRays.clear();
-		m_buffers.currRayCount = 0;
-		// ---- Create rays for all light sources ----
-		for (const auto& lightSource : m_lightSources)
-		{
-			m_buffers.createRay(RayData(
-				lightSource->originX, lightSource->originY,
-				lightSource->dirX, lightSource->dirY,
-				false, lightSource->whiteLight, 1.0f,
-				lightSource->color, lightSource->wavelength
-			));
-		}
-		// ---- Commit the new rays to the buffer ----
-		m_buffers.commitNewRays();
 		// ---- Reset flag ----
 		m_stateChange = false;
+		// ---- Only a finished trace has a whole tree to patch, one still going just starts again ----
+		if (m_incrementalTracing && m_rayTree.isRecording() && m_buffers.currRayCount == 0)
+		{
+			m_retraceChanged = true;
+			return;
+		}
+		sRestartTrace();
+	}
+	// ---- Hero wavelength mode keeps adding passes to a converged trace until it has them all ----
+	else if (m_heroWavelengths && m_buffers.currRayCount == 0 && m_spectralPass + 1 < m_spectralPasses)
+	{
+		sEmitSpectralPass();
 	}
 	return;
 }
 
+void Simulation::sRestartTrace()
+{
+	m_retraceChanged = false;
+	// ---- Reset buffers and clear all rays ----
+	allRays.clear();
+	m_rayLayerDirty = true;
+	m_rayIndexDirty = true;
+	m_buffers.currRayCount = 0;
+	m_spectralPass = 0;
+	// ---- Record the new trace, sCollisionv2 adds the entities it was traced against ----
+	// Hero wavelength passes are random so there's no replaying part of one, they always start again
+	// Neither is there with dispersion bundles, the tree has no record of the probes that go with each one
+	if (m_incrementalTracing && !m_heroWavelengths && !m_lazyDispersion) m_rayTree.start(traceInputsSignature(), traceSources());
+	else m_rayTree.clear();
+	// ---- Copy every light source into the buffers in one go, they are already contiguous ----
+	m_buffers.appendRays(m_lightSources.data(), m_lightSources.size());
+	if (m_rayTree.isRecording())
+	{
+		for (uint i = 0; i < m_buffers.currRayCount; ++i)
+		{
+			m_buffers.raySources[i] = m_rayTree.sourceId(RayTree::lightSourceKey(m_lightSources.handleAt(i)));
+		}
+	}
+	// ---- Emitters write their rays straight into the device buffers after them ----
+	sEmitRays();
+	if (m_heroWavelengths) shareWhiteLight(0, m_buffers.currRayCount, 1.0f / m_spectralPasses);
+	// ---- Detectors start counting from zero again ----
+	m_buffers.detectorHistogram.reset();
+	m_traceScheduler.resetDetectors();
+	m_traceProfiler.begin();
+}
+
+void Simulation::sRetraceChanged(const RayTree::Scene& scene)
+{
+	m_retraceChanged = false;
+	std::vector<RayData> retrace;
+	std::vector<RayTree::SourceKey> emit;
+	if (!m_rayTree.invalidate(scene, traceInputsSignature(), traceSources(), retrace, emit) || retrace.size() > RayCollisionBuffers::maxBufferSize)
+	{
+		sRestartTrace();
+		if (m_rayTree.isRecording()) m_rayTree.setScene(scene);
+		return;
+	}
+	// ---- Draw what was kept, trace the rest again from where it was cut off ----
+	allRays.clear();
+	m_rayTree.appendSegments(allRays);
+	m_rayLayerDirty = true;
+	m_rayIndexDirty = true;
+	m_buffers.currRayCount = 0;
+	m_buffers.appendRays(retrace.data(), retrace.size());
+	// ---- Light sources and emitters that moved start again from scratch, the rest keep their rays ----
+	std::vector<SlotHandle> emitters;
+	for (RayTree::SourceKey key : emit)
+	{
+		const SlotHandle handle = RayTree::sourceHandle(key);
+		if (RayTree::isEmitter(key))
+		{
+			emitters.push_back(handle);
+		}
+		else if (const RayData* light = m_lightSources.get(handle))
+		{
+			RayData ray = *light;
+			ray.source = m_rayTree.sourceId(key);
+			m_buffers.appendRays(&ray, 1);
+		}
+	}
+	sEmitRays(emitters);
+	m_traceProfiler.begin();
+}
+
+void Simulation::sEmitSpectralPass()
+{
+	m_spectralPass++;
+	m_rayLayerDirty = true;
+	m_rayIndexDirty = true;
+	m_buffers.currRayCount = 0;
+	// ---- Coloured light was traced in full by the first pass, only white light has more of the spectrum to sample ----
+	std::vector<RayData> whiteLight;
+	for (const RayData& ray : m_lightSources)
+	{
+		if (ray.whiteLight) whiteLight.push_back(ray);
+	}
+	m_buffers.appendRays(whiteLight.data(), whiteLight.size());
+	std::vector<SlotHandle> emitters;
+	for (size_t i = 0; i < m_emitters.size(); ++i)
+	{
+		if (m_emitters.data()[i].whiteLight) emitters.push_back(m_emitters.handleAt(i));
+	}
+	sEmitRays(emitters);
+	shareWhiteLight(0, m_buffers.currRayCount, 1.0f / m_spectralPasses);
+	m_traceProfiler.begin();
+}
+
+void Simulation::uploadMaterials()
+{
+	auto& profiles = m_sellmeierManager.getProfiles();
+	if (profiles.size() > RayCollisionBuffers::maxMaterials)
+	{
+		std::cerr << "Too many materials, only the first " << RayCollisionBuffers::maxMaterials << " are sent to the GPU" << std::endl;
+	}
+	const uint materialCount = std::min<uint>(profiles.size(), RayCollisionBuffers::maxMaterials);
+	const uint tableSize = RayCollisionBuffers::indexTableSize;
+	for (uint material = 0; material < materialCount; ++material)
+	{
+		Sellmeier& profile = *profiles[material];
+		for (int i = 0; i < 3; i++)
+		{
+			m_buffers.sellmeierCoefficientsA[material * 3 + i] = profile.getCoefficientsA()[i];
+			m_buffers.sellmeierCoefficientsB[material * 3 + i] = profile.getCoefficientsB()[i];
+		}
+		// Worked out in double once here so the kernel only has to blend two neighbouring samples
+		for (uint sample = 0; sample < tableSize; ++sample)
+		{
+			const double wavelength = m_startWavelength + (m_endWavelength - m_startWavelength) * sample / (tableSize - 1.0);
+			m_buffers.refractiveIndexTable[material * tableSize + sample] = static_cast<float>(profile.calculateN(wavelength * 1e-3));
+		}
+	}
+	if (materialCount == 0) return;
+	m_buffers.sellmeierCoefficientsA.write_to_device(0, materialCount * 3);
+	m_buffers.sellmeierCoefficientsB.write_to_device(0, materialCount * 3);
+	m_buffers.refractiveIndexTable.write_to_device(0, materialCount * tableSize);
+}
+
+sf::Color Simulation::bandColour(float shortest, float longest) const
+{
+	if (m_spectrum.empty()) return sf::Color::White;
+	auto first = std::lower_bound(m_spectrum.begin(), m_spectrum.end(), shortest,
+		[](const std::pair<float, sf::Color>& entry, float wavelength) { return entry.first < wavelength; });
+	// Narrower than one step of the spectrum, take the wavelength just after it
+	if (first == m_spectrum.end() || first->first > longest) return first == m_spectrum.end() ? m_spectrum.back().second : first->second;
+
+	sf::Color colour(0, 0, 0, 0);
+	for (auto it = first; it != m_spectrum.end() && it->first <= longest; ++it)
+	{
+		colour.r = std::max(colour.r, it->second.r);
+		colour.g = std::max(colour.g, it->second.g);
+		colour.b = std::max(colour.b, it->second.b);
+		colour.a = std::max(colour.a, it->second.a);
+	}
+	return colour;
+}
+
+void Simulation::stageBundle(std::array<RayData, 3> rays, std::uint32_t& nextBundle)
+{
+	for (std::uint8_t role = 0; role < 3; ++role)
+	{
+		RayData& ray = rays[role];
+		ray.whiteLight = false;
+		ray.bundle = nextBundle;
+		ray.bundleRole = role;
+		ray.parent = RayTree::noParent;
+		// Probes only say where their end of the band goes, they carry no energy and are never drawn
+		if (role != 0)
+		{
+			ray.intensity = 0.0f;
+			ray.wavelengthSpan = 0.0f;
+		}
+		m_buffers.createRay(ray);
+	}
+	nextBundle++;
+}
+
+void Simulation::splitBundle(const std::array<RayData, 3>& launched, float separation, std::uint32_t& nextBundle)
+{
+	const RayData& centre = launched[0];
+	const float shortest = centre.wavelength - 0.5f * centre.wavelengthSpan;
+	const float longest = centre.wavelength + 0.5f * centre.wavelengthSpan;
+
+	// The ray t of the way along the band, a quadratic through the three that were traced so it follows the spread as it bends
+	auto rayAt = [&](float t) {
+		const float weights[3] = { -4.0f * t * (t - 1.0f), 2.0f * (t - 0.5f) * (t - 1.0f), 2.0f * t * (t - 0.5f) };
+		RayData ray = centre;
+		ray.originX = ray.originY = ray.dirX = ray.dirY = ray.refracIndex = 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			ray.originX += weights[k] * launched[k].originX;
+			ray.originY += weights[k] * launched[k].originY;
+			ray.dirX += weights[k] * launched[k].dirX;
+			ray.dirY += weights[k] * launched[k].dirY;
+			ray.refracIndex += weights[k] * launched[k].refracIndex;
+		}
+		// Rays start one direction's length past what they hit, so keep the length the centre had
+		const float length = std::hypot(centre.dirX, centre.dirY) / std::max(std::hypot(ray.dirX, ray.dirY), 1e-6f);
+		ray.dirX *= length;
+		ray.dirY *= length;
+		ray.wavelength = shortest + t * (longest - shortest);
+		return ray;
+		};
+
+	// How much the bundle has been dimmed since it split off the white ray, the pieces keep that
+	const sf::Color full = bandColour(shortest, longest);
+	const float dimming = std::max({ centre.color.r, centre.color.g, centre.color.b }) / std::max(1.0f, static_cast<float>(std::max({ full.r, full.g, full.b })));
+	auto dim = [dimming](const sf::Color& c) {
+		return sf::Color(
+			static_cast<int>(std::clamp(c.r * dimming, 0.f, 255.f)),
+			static_cast<int>(std::clamp(c.g * dimming, 0.f, 255.f)),
+			static_cast<int>(std::clamp(c.b * dimming, 0.f, 255.f)),
+			static_cast<int>(std::clamp(c.a * dimming, 15.f, 255.f)));
+		};
+
+	// Spread is roughly proportional to the width of the band, so this many pieces should each end up within the tolerance
+	const int pieces = std::clamp(static_cast<int>(std::ceil(separation / m_dispersionTolerance)), 2, maxBundleSplit);
+	if (centre.wavelengthSpan / pieces < minBundleSteps * m_step)
+	{
+		// ---- Narrow enough to give every wavelength in the band its own ray ----
+		auto before = [](const std::pair<float, sf::Color>& entry, float wavelength) { return entry.first < wavelength; };
+		auto first = std::lower_bound(m_spectrum.begin(), m_spectrum.end(), shortest, before);
+		// Half open so neighbouring bands don't both take the wavelength on their boundary, apart from the top of the spectrum
+		auto last = longest >= m_endWavelength ? m_spectrum.end() : std::lower_bound(first, m_spectrum.end(), longest, before);
+		const size_t count = last - first;
+		for (auto it = first; it != last; ++it)
+		{
+			RayData ray = rayAt((it->first - shortest) / std::max(longest - shortest, 1e-6f));
+			ray.wavelength = it->first;
+			ray.wavelengthSpan = 0.0f;
+			ray.bundle = noBundle;
+			ray.bundleRole = 0;
+			ray.color = dim(it->second);
+			ray.intensity = centre.intensity / static_cast<float>(count);
+			m_buffers.createRay(ray);
+		}
+		return;
+	}
+
+	// ---- Otherwise into narrower bundles, the probes of each piece are its ends ----
+	for (int p = 0; p < pieces; ++p)
+	{
+		const float from = static_cast<float>(p) / pieces;
+		const float to = static_cast<float>(p + 1) / pieces;
+		std::array<RayData, 3> piece = { rayAt(0.5f * (from + to)), rayAt(from), rayAt(to) };
+		piece[0].wavelengthSpan = centre.wavelengthSpan / pieces;
+		piece[0].intensity = centre.intensity / pieces;
+		piece[0].color = dim(bandColour(piece[1].wavelength, piece[2].wavelength));
+		stageBundle(piece, nextBundle);
+	}
+}
+
+void Simulation::shareWhiteLight(uint first, uint end, float share)
+{
+	if (first >= end) return;
+	for (uint i = first; i < end; ++i)
+	{
+		if (m_buffers.whiteLight[i]) m_buffers.rayIntensities[i] *= share;
+	}
+	// Emitted rays are already on the device and only the host's are uploaded before the trace, so send the lot
+	m_buffers.rayIntensities.write_to_device(first, end - first);
+}
+
+RayTree::Sources Simulation::traceSources() const
+{
+	RayTree::Sources sources;
+	for (size_t i = 0; i < m_lightSources.size(); ++i)
+	{
+		std::uint64_t signature = RayTree::hashSeed;
+		RayTree::hash(signature, m_lightSources.data()[i]);
+		sources[RayTree::lightSourceKey(m_lightSources.handleAt(i))] = signature;
+	}
+	for (size_t i = 0; i < m_emitters.size(); ++i)
+	{
+		std::uint64_t signature = RayTree::hashSeed;
+		RayTree::hash(signature, m_emitters.data()[i]);
+		sources[RayTree::emitterKey(m_emitters.handleAt(i))] = signature;
+	}
+	return sources;
+}
+
+std::uint64_t Simulation::traceInputsSignature()
+{
+	std::uint64_t signature = RayTree::hashSeed;
+	// Rays that miss everything stop at the world bounds
+	RayTree::hash(signature, m_worldBounds.position.x);
+	RayTree::hash(signature, m_worldBounds.position.y);
+	RayTree::hash(signature, m_worldBounds.size.x);
+	RayTree::hash(signature, m_worldBounds.size.y);
+
+	// What white light splits into and what every glass is made of
+	RayTree::hash(signature, wavelengthColors.size());
+	RayTree::hash(signature, m_startWavelength);
+	RayTree::hash(signature, m_endWavelength);
+	RayTree::hash(signature, m_heroWavelengths);
+	RayTree::hash(signature, m_lazyDispersion);
+	RayTree::hash(signature, m_dispersionTolerance);
+	for (auto& profile : m_sellmeierManager.getProfiles())
+	{
+		for (double coefficient : profile->getCoefficientsA()) RayTree::hash(signature, coefficient);
+		for (double coefficient : profile->getCoefficientsB()) RayTree::hash(signature, coefficient);
+	}
+	return signature;
+}
+
 void Simulation::sRender()
 {
 	m_window.clear();
 	// ---- Draw all rays ----
-	m_window.draw(allRays, m_blendMode);
+	if (m_buffers.currRayCount > 0)
+	{
+		// Still tracing so allRays changes every frame, no point caching it
+		m_window.draw(allRays, m_blendMode);
+	}
+	else
+	{
+		// Trace has converged, just blit the cached layer
+		sUpdateRayLayer();
+		sf::View view = m_window.getView();
+		m_window.setView(m_window.getDefaultView());
+		m_window.draw(sf::Sprite(m_rayLayer.getTexture()), sf::BlendNone);
+		m_window.setView(view);
+	}
 	// ---- Draw all entities ----
 	for (auto& e : m_entities.getEntities())
 	{
@@ -167,18 +477,86 @@ void Simulation::sRender()
 	m_window.display();
 }
 
+void Simulation::sUpdateRayLayer()
+{
+	sf::Vector2u windowSize = m_window.getSize();
+	const sf::View& view = m_window.getView();
+
+	if (m_rayLayer.getSize() != windowSize)
+	{
+		if (!m_rayLayer.resize(windowSize))
+		{
+			std::cerr << "Failed to resize ray layer to " << windowSize.x << "x" << windowSize.y << "\n";
+			return;
+		}
+		m_rayLayerDirty = true;
+	}
+
+	// Panning or zooming moves the rays on screen so the layer has to be redrawn
+	bool viewChanged = view.getCenter() != m_rayLayerView.getCenter() ||
+		view.getSize() != m_rayLayerView.getSize() ||
+		view.getRotation() != m_rayLayerView.getRotation();
+
+	if (!m_rayLayerDirty && !viewChanged) return;
+
+	m_rayLayer.setView(view);
+	m_rayLayer.clear();
+	m_rayLayer.draw(visibleRays(view), m_blendMode);
+	m_rayLayer.display();
+
+	m_rayLayerView = view;
+	m_rayLayerDirty = false;
+}
+
+const sf::VertexArray& Simulation::visibleRays(const sf::View& view)
+{
+	// Still tracing so allRays changes every frame, indexing it would cost more than drawing it
+	if (m_buffers.currRayCount > 0) return allRays;
+	if (m_rayIndexDirty)
+	{
+		m_rayIndex.build(allRays);
+		m_rayIndexDirty = false;
+	}
+	// Whatever the view's rotation, the world rectangle around everything it shows
+	const sf::FloatRect viewRect = view.getInverseTransform().transformRect(sf::FloatRect({ -1.0f, -1.0f }, { 2.0f, 2.0f }));
+	return m_rayIndex.query(allRays, viewRect, m_visibleRays);
+}
+
 void Simulation::sUpdateAlpha()
 {
-	for (auto& e : m_entities.getEntities())
+	for (auto& [shape, e] : m_entities.components<CCustomShape>())
 	{
-		if (e->cCustomShape)
+		if (PrismDemoShape* prism = shape.as<PrismDemoShape>())
 		{
-			// If the shape is a prism demo shape then update the alpha value 
-			if (auto* demoShape = dynamic_cast<PrismDemoShape*>(e->cCustomShape->customShape.get()))
-			{
-				demoShape->updateAlpha();
-				m_stateChange = true;
-			}
+			prism->updateAlpha();
+			m_entities.refreshBounds(e);
+			m_stateChange = true;
+		}
+	}
+}
+
+void Simulation::sUpdateTessellation()
+{
+	float maxError = m_maxChordError;
+	sf::Vector2u windowSize = m_window.getSize();
+	if (m_zoomAwareTessellation && windowSize.x > 0)
+	{
+		float worldPerPixel = m_view.getSize().x / static_cast<float>(windowSize.x);
+		// Snapped to powers of two so zooming only re-tessellates once per doubling rather than every scroll tick
+		float pixelError = m_maxChordErrorPixels * std::exp2(std::floor(std::log2(worldPerPixel)));
+		maxError = std::min(maxError, pixelError);
+	}
+
+	// Cheap when nothing changed, the setters return straight away
+	for (auto& packed : m_entities.components<CCustomShape>())
+	{
+		if (MyLensShape* lens = packed.component.as<MyLensShape>())
+		{
+			if (lens->setMaxChordError(maxError)) m_stateChange = true;
+		}
+		else if (CircularArcShape* arc = packed.component.as<CircularArcShape>())
+		{
+			if (arc->setMaxChordError(maxError)) m_stateChange = true;
 		}
 	}
 }
@@ -219,9 +597,9 @@ void Simulation::sCreateLens(const sf::Vector2f& lensPos, const float width, con
 void Simulation::sCreateDemoPrism(const sf::Vector2f& position, const float width, const float angle, const sf::Color& fillColor, const sf::Color& borderColor, const std::string& material)
 {
 	// Just some random data as it gets updated immediately 
-	RayData* ray = sCreateWhiteRay({ 0.0f, 0.0f }, { 1.0f, 0.0f }); 
+	SlotHandle ray = sCreateWhiteRay({ 0.0f, 0.0f }, { 1.0f, 0.0f }); 
 	// ---- Create the demo prism and set its properties ----
-	std::unique_ptr<PrismDemoShape> prismShape = std::make_unique<PrismDemoShape>(width, angle, position,ray);
+	std::unique_ptr<PrismDemoShape> prismShape = std::make_unique<PrismDemoShape>(width, angle, position, m_lightSources, ray);
 	prismShape->setFillColor(fillColor);
 	prismShape->setOutlineColor(borderColor);
 	prismShape->setOutlineThickness(1.0f);
@@ -250,7 +628,7 @@ Entity* Simulation::sCreateCustomPolygonPrism(const sf::Vector2f& position, cons
 		45.0f);
 	marker->cMarker = std::make_unique<CMarker>(EntityTag(), MarkerRole::polygonPrismMarker, customPrism);
 	customPrism->cCustomShape = std::make_unique<CCustomShape>(std::make_unique<CustomPolygonPrism>(marker));
-	CustomPolygonPrism* customPrismShape = dynamic_cast<CustomPolygonPrism*>(customPrism->cCustomShape->customShape.get());
+	CustomPolygonPrism* customPrismShape = customPrism->cCustomShape->as<CustomPolygonPrism>();
 	customPrismShape->setFillColor(fillColour);
 	customPrismShape->setOutlineColor(borderColour);
 	customPrismShape->setOutlineThickness(1.0f);
@@ -286,27 +664,112 @@ Entity* Simulation::sCreateCircularArc(Entity* m1, Entity* m2, Entity* m3, const
 	return e;
 }
 
+Entity* Simulation::sCreateDetector(const sf::Color& colour)
+{
+	auto detectorShape = std::make_unique<DetectorShape>();
+	detectorShape->setOutlineColor(colour);
+
+	Entity* e = &m_entities.addEntity("Detector");
+	e->cCustomShape = std::make_unique<CCustomShape>(std::move(detectorShape));
+	e->m_isDetector = true;
+
+	return e;
+}
+
 
-RayData* Simulation::sCreateWhiteRay(sf::Vector2f origin, sf::Vector2f dir)
+SlotHandle Simulation::sCreateWhiteRay(sf::Vector2f origin, sf::Vector2f dir)
 {
-	m_lightSources.emplace_back(std::make_unique<RayData>(
+	return m_lightSources.insert(RayData(
 		origin.x, origin.y, dir.x, dir.y,
 		false, true, 1.0f,
 		sf::Color(255, 255, 255, 255),
 		0.0f));
-	return m_lightSources.back().get();
 }
 
-RayData* Simulation::sCreateColouredRay(sf::Vector2f origin, sf::Vector2f dir, float wavelength)
+SlotHandle Simulation::sCreateEmitter(const Emitter& settings)
+{
+	return m_emitters.insert(settings);
+}
+
+void Simulation::sEmitRays()
+{
+	std::vector<SlotHandle> emitters;
+	for (size_t i = 0; i < m_emitters.size(); ++i)
+	{
+		emitters.push_back(m_emitters.handleAt(i));
+	}
+	sEmitRays(emitters);
+}
+
+void Simulation::sEmitRays(const std::vector<SlotHandle>& emitters)
+{
+	const uint firstEmittedRay = m_buffers.currRayCount;
+	for (SlotHandle handle : emitters)
+	{
+		const Emitter* found = m_emitters.get(handle);
+		if (found == nullptr) continue;
+		const Emitter& emitter = *found;
+		const uint first = m_buffers.currRayCount;
+		const uint count = std::min<uint>(emitter.rayCount, RayCollisionBuffers::maxBufferSize - first);
+		if (count < emitter.rayCount)
+		{
+			std::cerr << "Ray buffer is full! Cannot add more rays." << std::endl;
+		}
+		if (count == 0) break;
+
+		const uint isWhiteLight = emitter.whiteLight ? 1u : 0u;
+		Kernel generateRays(
+			m_device, count, "generate_emitter_rays",
+			m_buffers.rayOriginsX, m_buffers.rayOriginsY,
+			m_buffers.rayDirsX, m_buffers.rayDirsY,
+			m_buffers.whiteLight, m_buffers.refracIndices,
+			m_buffers.wavelengths, m_buffers.rayIntensities,
+			m_buffers.finishedProcessing,
+			first, count, static_cast<int>(emitter.type),
+			emitter.origin.x, emitter.origin.y,
+			emitter.direction.x, emitter.direction.y,
+			emitter.width, emitter.halfAngle,
+			isWhiteLight, emitter.wavelength
+		);
+		generateRays.run();
+
+		// Colours are only used for drawing so they never go near the GPU
+		std::fill(m_buffers.rayColours.begin() + first, m_buffers.rayColours.begin() + first + count, emitter.color);
+		std::fill(m_buffers.rayParents.begin() + first, m_buffers.rayParents.begin() + first + count, RayTree::noParent);
+		const std::uint32_t source = m_rayTree.isRecording() ? m_rayTree.sourceId(RayTree::emitterKey(handle)) : RayTree::noSource;
+		std::fill(m_buffers.raySources.begin() + first, m_buffers.raySources.begin() + first + count, source);
+		std::fill(m_buffers.rayBundles.begin() + first, m_buffers.rayBundles.begin() + first + count, noBundle);
+		std::fill(m_buffers.wavelengthSpans.data() + first, m_buffers.wavelengthSpans.data() + first + count, 0.0f);
+		m_buffers.wavelengthSpans.write_to_device(first, count);
+		std::fill(m_buffers.knownEdges.data() + first, m_buffers.knownEdges.data() + first + count, -1);
+		m_buffers.knownEdges.write_to_device(first, count);
+		m_buffers.currRayCount += count;
+	}
+
+	const uint emitted = m_buffers.currRayCount - firstEmittedRay;
+	if (emitted == 0) return;
+
+	// sCollisionv2 still reads the rays on the host to draw segments and spawn children, so bring one copy back in bulk
+	m_buffers.rayOriginsX.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.rayOriginsY.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.rayDirsX.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.rayDirsY.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.whiteLight.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.refracIndices.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.wavelengths.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.rayIntensities.read_from_device(firstEmittedRay, emitted, false);
+	m_buffers.finishedProcessing.read_from_device(firstEmittedRay, emitted);
+}
+
+SlotHandle Simulation::sCreateColouredRay(sf::Vector2f origin, sf::Vector2f dir, float wavelength)
 {
 	// std::cout << "Creating coloured ray with wavelength: " << wavelength << " nm\n";
 	sf::Color color = wavelengthToRGB(wavelength);
-	m_lightSources.emplace_back(std::make_unique<RayData>(
+	return m_lightSources.insert(RayData(
 		origin.x, origin.y, dir.x, dir.y,
 		false, false, 1.0f,
 		color,
 		wavelength));
-	return m_lightSources.back().get();
 }
 
 void Simulation::sUpdateLensMarkerPositions(Entity* leftInsetMarker, Entity* rightInsetMarker, Entity* widthAndHeightMarker)
@@ -314,7 +777,7 @@ void Simulation::sUpdateLensMarkerPositions(Entity* leftInsetMarker, Entity* rig
 	if (!leftInsetMarker || !rightInsetMarker || !widthAndHeightMarker) return;
 	// Assume all markers have the same Lens target Entity in CMarker
 	Entity* lens = leftInsetMarker->cMarker->getTargetEntity();
-	MyLensShape* lensShape = dynamic_cast<MyLensShape*>(lens->cCustomShape->customShape.get());
+	MyLensShape* lensShape = lens->cCustomShape->as<MyLensShape>();
 	sf::Vector2f lensPos = lensShape->getPosition();
 	float lensHeight = lensShape->getHeight();
 	float lensWidth = lensShape->getWidth();
@@ -377,7 +840,7 @@ void Simulation::sRenderScreenShot(sf::RenderTarget& target)
 {
 	target.clear();
 
-	target.draw(allRays, m_blendMode);
+	target.draw(visibleRays(target.getView()), m_blendMode);
 
 	for (auto& e : m_entities.getEntities())
 	{
@@ -393,26 +856,108 @@ void Simulation::sRenderScreenShot(sf::RenderTarget& target)
 
 }
 
+void Simulation::finishTrace()
+{
+	// Rays still bouncing between mirrors never finish, so don't let one pass trace forever
+	const int maxTracePasses = 100;
+	int passes = 0;
+	while (passes < maxTracePasses)
+	{
+		if (m_buffers.currRayCount == 0 && !m_retraceChanged)
+		{
+			// Converged, hero wavelength mode moves on to its next pass the same as the main loop would
+			if (!m_heroWavelengths || m_spectralPass + 1 >= m_spectralPasses) return;
+			sEmitSpectralPass();
+			passes = 0;
+		}
+		sCollisionv2();
+		passes++;
+	}
+}
+
 void Simulation::saveScreenshot(const std::string& filename, unsigned int scaleFactor)
 {
+	finishTrace();
+
 	sf::Vector2u windowSize = m_window.getSize();
 	sf::Vector2u screenshotSize = windowSize * scaleFactor;
 
-	sf::RenderTexture renderTexture(screenshotSize);
+	// A single texture of the whole screenshot goes over the texture size limit on a lot of devices,
+	// so render it a strip at a time and stream each strip into the PNG instead
+	const unsigned int maxTextureSize = sf::Texture::getMaximumSize();
+	const unsigned int tileWidth = std::min(maxTextureSize, 2048u);
+	const unsigned int stripHeight = std::min(maxTextureSize, 256u);
+
+	sf::RenderTexture tile;
+	if (!tile.resize({ tileWidth, stripHeight }))
+	{
+		std::cerr << "Failed to create screenshot tile\n";
+		return;
+	}
+
+	PngWriter png;
+	if (!png.open(filename, screenshotSize.x, screenshotSize.y))
+	{
+		std::cerr << "Failed to save screenshot to " << filename << "\n";
+		return;
+	}
 
-	// Use the current view without changing size
+	// World units per screenshot pixel for the current view
 	sf::View currentView = m_window.getView();
-	// Make sure the viewport covers the entire render texture
-	currentView.setViewport(sf::FloatRect({ 0.f, 0.f }, { 1.f, 1.f }));
+	sf::Vector2f worldTopLeft = currentView.getCenter() - currentView.getSize() / 2.f;
+	sf::Vector2f worldPerPixel(currentView.getSize().x / screenshotSize.x, currentView.getSize().y / screenshotSize.y);
+
+	// Strips are compressed on worker threads while the next one renders, cap how many are held at once to bound memory
+	const size_t maxStripsInFlight = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 4);
+	std::deque<std::future<PngStrip>> pendingStrips;
+	bool success = true;
+
+	for (unsigned int y0 = 0; y0 < screenshotSize.y; y0 += stripHeight)
+	{
+		unsigned int rows = std::min(stripHeight, screenshotSize.y - y0);
+		auto strip = std::make_shared<std::vector<std::uint8_t>>(static_cast<size_t>(screenshotSize.x) * rows * 4);
+
+		for (unsigned int x0 = 0; x0 < screenshotSize.x; x0 += tileWidth)
+		{
+			unsigned int cols = std::min(tileWidth, screenshotSize.x - x0);
+
+			// The view always covers a whole tile so the scale matches, anything past the edge of the image is thrown away
+			sf::View tileView(sf::FloatRect(
+				{ worldTopLeft.x + x0 * worldPerPixel.x, worldTopLeft.y + y0 * worldPerPixel.y },
+				{ tileWidth * worldPerPixel.x, stripHeight * worldPerPixel.y }));
+			tile.setView(tileView);
+			sRenderScreenShot(tile);
+			tile.display();
+
+			sf::Image tileImage = tile.getTexture().copyToImage();
+			const std::uint8_t* pixels = tileImage.getPixelsPtr();
+			for (unsigned int r = 0; r < rows; ++r)
+			{
+				std::memcpy(strip->data() + (static_cast<size_t>(r) * screenshotSize.x + x0) * 4,
+					pixels + static_cast<size_t>(r) * tileWidth * 4,
+					static_cast<size_t>(cols) * 4);
+			}
+		}
 
-	renderTexture.setView(currentView);
+		if (pendingStrips.size() >= maxStripsInFlight)
+		{
+			success = png.appendStrip(pendingStrips.front().get()) && success;
+			pendingStrips.pop_front();
+		}
+		unsigned int width = screenshotSize.x;
+		pendingStrips.push_back(std::async(std::launch::async, [strip, width, rows]() {
+			return PngWriter::compressRows(strip->data(), width, rows);
+			}));
+	}
 
-	renderTexture.clear(sf::Color::Black);
-	sRenderScreenShot(renderTexture);
-	renderTexture.display();
+	while (!pendingStrips.empty())
+	{
+		success = png.appendStrip(pendingStrips.front().get()) && success;
+		pendingStrips.pop_front();
+	}
+	success = png.close() && success;
 
-	sf::Image screenshot = renderTexture.getTexture().copyToImage();
-	if (screenshot.saveToFile(filename)) {
+	if (success) {
 		std::cout << "Screenshot saved to " << filename << "\n";
 	}
 	else {
@@ -420,24 +965,103 @@ void Simulation::saveScreenshot(const std::string& filename, unsigned int scaleF
 	}
 }
 
+void Simulation::exportFrameSequence(const std::string& directory, int frameCount)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		std::cerr << "Failed to create " << directory << ": " << error.message() << "\n";
+		return;
+	}
+
+	sf::RenderTexture frame;
+	if (!frame.resize(m_window.getSize()))
+	{
+		std::cerr << "Failed to create frame texture\n";
+		return;
+	}
+	frame.setView(m_window.getView());
+
+	// Encoding PNGs is slower than tracing a frame so spread it over the cores, but bound how many frames are held in memory
+	const size_t maxFramesInFlight = std::max(2u, std::thread::hardware_concurrency());
+	std::deque<std::future<bool>> pendingFrames;
+	int framesFailed = 0;
+	sf::Clock exportClock;
+
+	for (int i = 0; i < frameCount; ++i)
+	{
+		// Same steps the main loop takes, just without waiting for the next frame
+		sUpdateWavelengthCreation();
+		sUpdateAlpha();
+		sHandleStateChange();
+		finishTrace();
+
+		sRenderScreenShot(frame);
+		frame.display();
+		auto image = std::make_shared<sf::Image>(frame.getTexture().copyToImage());
+
+		char name[32];
+		snprintf(name, sizeof(name), "/frame_%05d.png", i);
+		std::string filename = directory + name;
+
+		if (pendingFrames.size() >= maxFramesInFlight)
+		{
+			if (!pendingFrames.front().get()) framesFailed++;
+			pendingFrames.pop_front();
+		}
+		pendingFrames.push_back(std::async(std::launch::async, [image, filename]() {
+			return image->saveToFile(filename);
+			}));
+
+		if ((i + 1) % 60 == 0)
+		{
+			std::cout << "Exported " << (i + 1) << "/" << frameCount << " frames\n";
+		}
+		// The export runs on the GUI thread so ImGui can't draw anything until it's done, the title bar is the only thing that still updates
+		if ((i + 1) % 10 == 0 || i + 1 == frameCount)
+		{
+			m_window.setTitle("SIMULATION - exporting frame " + std::to_string(i + 1) + "/" + std::to_string(frameCount));
+		}
+	}
+
+	while (!pendingFrames.empty())
+	{
+		if (!pendingFrames.front().get()) framesFailed++;
+		pendingFrames.pop_front();
+	}
+
+	m_window.setTitle("SIMULATION");
+
+	// The live view needs retracing as the scene has moved on
+	m_stateChange = true;
+
+	if (framesFailed == 0)
+	{
+		std::cout << "Exported " << frameCount << " frames to " << directory << " in " << exportClock.getElapsedTime().asSeconds() << " s\n";
+	}
+	else
+	{
+		std::cerr << framesFailed << " of " << frameCount << " frames failed to save to " << directory << "\n";
+	}
+}
+
 // Writing this made me realise if possible (as I don't know) that if we could have much more of the logic on GPU to reduce writes it would speed things up a lot 
 // If anyone is reading this and wants to make something similar you should probably just use openGL for the whole thing with compute shaders instead of openCL
 void Simulation::sCollisionv2()
 {
-	sf::Clock preProcessingClock;
-
-	sf::Vector2f viewSize   = m_view.getSize();
-	sf::Vector2f viewCenter = m_view.getCenter();
+	// Every ray has finished so the scene is static, no need to rebuild the edge buffers or re-upload anything
+	if (m_buffers.currRayCount == 0 && !m_retraceChanged) return;
+	m_rayLayerDirty = true;
+	m_rayIndexDirty = true;
 
-	float left = viewCenter.x - viewSize.x / 2.f;
-	float top  = viewCenter.y - viewSize.y / 2.f;
-
-	// Bounds in world coordinates  
-	m_buffers.screenBounds[0] = (uint)left;         // left (x)
+	sf::Clock preProcessingClock;
 
-	m_buffers.screenBounds[1] = (uint)top;          // top (y)
-	m_buffers.screenBounds[2] = (uint)viewSize.x;   // width
-	m_buffers.screenBounds[3] = (uint)viewSize.y;   // height
+	// Bounds in world coordinates, fixed rather than following the view so panning and zooming only ever re-render the rays
+	m_buffers.worldBounds[0] = m_worldBounds.position.x; // left (x)
+	m_buffers.worldBounds[1] = m_worldBounds.position.y; // top (y)
+	m_buffers.worldBounds[2] = m_worldBounds.size.x;     // width
+	m_buffers.worldBounds[3] = m_worldBounds.size.y;     // height
 
 	// Can do all entity data preparation outside of loop as it can't change in this function 
 	// We do not know the number of vertices in each entity, so we will create a vector to hold all vertices and their counts
@@ -450,110 +1074,143 @@ void Simulation::sCollisionv2()
 	std::vector<int> sellmeierIndices;
 
 	std::vector<Entity*> prismEntities;
+	RayTree::Scene scene; // Only filled in while the ray tree is recording
+	uint detectorCount = 0;
 	sf::Clock entityEdgeClock;
 	
-	int sellmeierIndex = 0;
-	for (auto& s : m_sellmeierManager.getProfiles())
+	// Materials only change when a profile is added (or the spectrum they're tabulated over changes), not every frame
+	const uint materialCount = std::min<uint>(m_sellmeierManager.getProfiles().size(), RayCollisionBuffers::maxMaterials);
+	std::uint64_t materials = RayTree::hashSeed;
+	RayTree::hash(materials, m_sellmeierManager.getVersion());
+	RayTree::hash(materials, m_startWavelength);
+	RayTree::hash(materials, m_endWavelength);
+	if (materials != m_uploadedMaterials)
 	{
-		for (int i = 0; i < 3; i++)
-		{
-			m_buffers.sellmeierCoefficientsA[sellmeierIndex] = (s->getCoefficientsA()[i]);
-			m_buffers.sellmeierCoefficientsB[sellmeierIndex] = (s->getCoefficientsB()[i]);
-			sellmeierIndex++;
-		}
+		uploadMaterials();
+		m_uploadedMaterials = materials;
 	}
-	m_buffers.sellmeierCoefficientsA.write_to_device(0,sellmeierIndex);
-	m_buffers.sellmeierCoefficientsB.write_to_device(0, sellmeierIndex);
 
-	for (auto& e : m_entities.getEntities())
+	for (Entity* e : m_entities.getOpticalEntities())
 	{
-		if (e->cPrism != nullptr || e->m_isMirror)
+		if (e->m_isDetector && detectorCount >= RayCollisionBuffers::maxDetectors)
 		{
-			prismEntities.push_back(e.get());
+			continue; // No room left in the histogram buffer, the ray just passes through
+		}
+		prismEntities.push_back(e);
 
-			if (e->cPrism != nullptr)
+		if (e->m_isDetector)
+		{
+			// Mirrors are -1 so detectors count down from -2, the kernel turns this back into the detector's histogram index
+			sellmeierIndices.push_back(-2 - static_cast<int>(detectorCount));
+			detectorCount++;
+		}
+		else if (e->cPrism != nullptr)
+		{
+			std::string sellmeierTag = e->cPrism->getTag();
+			int index = 0;
+			for (auto& s : m_sellmeierManager.getProfiles())
 			{
-				std::string sellmeierTag = e->cPrism->getTag();
-				int index = 0;
-				for (auto& s : m_sellmeierManager.getProfiles())
+				if (s->getTag() == sellmeierTag)
 				{
-					if (s->getTag() == sellmeierTag)
-					{
-						sellmeierIndices.push_back(index); // One per prism entity
-						break;
-					}
-					index++;
+					sellmeierIndices.push_back(index); // One per prism entity
+					break;
 				}
+				index++;
 			}
-			else
-			{
-				sellmeierIndices.push_back(-1);
-			}
+		}
+		else
+		{
+			sellmeierIndices.push_back(-1);
+		}
 
-			std::vector<sf::Vector2f> worldPolygon;
+		std::vector<sf::Vector2f> worldPolygon;
 
-			if (e->cShape != nullptr)
-			{
-				auto& shape = e->cShape->circle;
-				sf::Transform globalTransform = shape.getTransform();
+		if (e->cShape != nullptr)
+		{
+			auto& shape = e->cShape->circle;
+			sf::Transform globalTransform = shape.getTransform();
 
-				for (size_t i = 0; i < shape.getPointCount(); ++i)
-				{
-					sf::Vector2f localPoint = shape.getPoint(i);
-					sf::Vector2f worldPoint = globalTransform.transformPoint(localPoint);
-					worldPolygon.push_back(worldPoint);
-				}
-			}
-			else if (e->cCustomShape)
+			for (size_t i = 0; i < shape.getPointCount(); ++i)
 			{
-				CustomPolygonPrism* customPrismShape = dynamic_cast<CustomPolygonPrism*>(e->cCustomShape->customShape.get());
-				if (customPrismShape && !customPrismShape->getShapeComplete())
-					continue;
+				sf::Vector2f localPoint = shape.getPoint(i);
+				sf::Vector2f worldPoint = globalTransform.transformPoint(localPoint);
+				worldPolygon.push_back(worldPoint);
+			}
+		}
+		else if (e->cCustomShape)
+		{
+			CustomPolygonPrism* customPrismShape = e->cCustomShape->as<CustomPolygonPrism>();
+			if (customPrismShape && !customPrismShape->getShapeComplete())
+				continue;
 
-				auto& customShape = e->cCustomShape->customShape;
-				sf::Transform globalTransform = customShape->getTransform();
+			auto& customShape = e->cCustomShape->customShape;
+			sf::Transform globalTransform = customShape->getTransform();
 
-				for (size_t i = 0; i < customShape->getPointCount(); ++i)
-				{
-					sf::Vector2f localPoint = customShape->getPoint(i);
-					sf::Vector2f worldPoint = globalTransform.transformPoint(localPoint);
-					worldPolygon.push_back(worldPoint);
-				}
+			for (size_t i = 0; i < customShape->getPointCount(); ++i)
+			{
+				sf::Vector2f localPoint = customShape->getPoint(i);
+				sf::Vector2f worldPoint = globalTransform.transformPoint(localPoint);
+				worldPolygon.push_back(worldPoint);
+			}
 
-				// Ensure clockwise winding
-				auto signedArea = [](const std::vector<sf::Vector2f>& pts) -> float {
-					float area = 0.f;
-					size_t n = pts.size();
-					for (size_t i = 0; i < n; ++i)
-					{
-						const auto& p1 = pts[i];
-						const auto& p2 = pts[(i + 1) % n];
-						area += (p2.x - p1.x) * (p2.y + p1.y);
-					}
-					return area;
-					};
-				if (signedArea(worldPolygon) > 0)
+			// Ensure clockwise winding
+			auto signedArea = [](const std::vector<sf::Vector2f>& pts) -> float {
+				float area = 0.f;
+				size_t n = pts.size();
+				for (size_t i = 0; i < n; ++i)
 				{
-					std::reverse(worldPolygon.begin(), worldPolygon.end());
+					const auto& p1 = pts[i];
+					const auto& p2 = pts[(i + 1) % n];
+					area += (p2.x - p1.x) * (p2.y + p1.y);
 				}
+				return area;
+				};
+			if (signedArea(worldPolygon) > 0)
+			{
+				std::reverse(worldPolygon.begin(), worldPolygon.end());
 			}
+		}
 
-			// Generate edges
-			int edgeCount = worldPolygon.size();
-			bool isCircularArc = (e->getTag() == "CircularArc");
-			int limit = isCircularArc ? edgeCount - 1 : edgeCount;
+		// Generate edges
+		int edgeCount = worldPolygon.size();
+		// Arcs and detectors are open shapes, closing them would add an edge back along the shape
+		bool isOpenShape = (e->getTag() == "CircularArc" || e->m_isDetector);
+		int limit = isOpenShape ? edgeCount - 1 : edgeCount;
 
-			for (int i = 0; i < limit; ++i)
+		if (m_rayTree.isRecording() && !worldPolygon.empty())
+		{
+			// ---- What the ray tree needs to tell if this entity has changed since it was traced ----
+			RayTree::EntityState state;
+			sf::Vector2f minPoint = worldPolygon[0], maxPoint = worldPolygon[0];
+			for (const sf::Vector2f& point : worldPolygon)
 			{
-				sf::Vector2f a = worldPolygon[i];
-				sf::Vector2f b = worldPolygon[(i + 1) % worldPolygon.size()];
-
-				edgeA_X.push_back(a.x);
-				edgeA_Y.push_back(a.y);
-				edgeB_X.push_back(b.x);
-				edgeB_Y.push_back(b.y);
-				edgeEntityIndices.push_back(prismEntities.size() - 1); // index into prismEntities
+				minPoint = { std::min(minPoint.x, point.x), std::min(minPoint.y, point.y) };
+				maxPoint = { std::max(maxPoint.x, point.x), std::max(maxPoint.y, point.y) };
+				RayTree::hash(state.signature, point.x);
+				RayTree::hash(state.signature, point.y);
 			}
+			state.bounds = sf::FloatRect(minPoint, maxPoint - minPoint);
+			RayTree::hash(state.signature, isOpenShape);
+			RayTree::hash(state.signature, e->m_isMirror);
+			RayTree::hash(state.signature, e->m_isDetector);
+			if (e->cPrism != nullptr)
+			{
+				const std::string tag = e->cPrism->getTag();
+				RayTree::hash(state.signature, tag.data(), tag.size());
+			}
+			scene[e->getID()] = state;
+		}
+
+		for (int i = 0; i < limit; ++i)
+		{
+			sf::Vector2f a = worldPolygon[i];
+			sf::Vector2f b = worldPolygon[(i + 1) % worldPolygon.size()];
+
+			edgeA_X.push_back(a.x);
+			edgeA_Y.push_back(a.y);
+			edgeB_X.push_back(b.x);
+			edgeB_Y.push_back(b.y);
+			edgeEntityIndices.push_back(prismEntities.size() - 1); // index into prismEntities
 		}
 	}
 
@@ -579,8 +1236,16 @@ void Simulation::sCollisionv2()
 	m_buffers.edgeB_X.write_to_device(0,edgeCount);
 	m_buffers.edgeB_Y.write_to_device(0,edgeCount);
 	m_buffers.edgeEntityIndices.write_to_device(0,edgeCount);
-	m_buffers.screenBounds.write_to_device(); // Entire thing can be written
+	m_buffers.worldBounds.write_to_device(); // Entire thing can be written
+	m_traceScheduler.uploadScene(m_buffers, edgeCount, prismEntities.size(), materialCount, materials);
+	m_kernelVariant = m_specialiseKernels ? sceneKernelVariant(sellmeierIndices, prismEntities.size()) : "";
+	// Compiling a variant takes far longer than a frame, so it happens in the background as soon as the scene needs it.
+	// traceSlice keeps using the generic kernel, which gives the same result, until it's done
+	m_traceScheduler.prepareVariant(m_kernelVariant);
 
+	// ---- Patch the last trace now it's known what moved, or remember what this trace started with ----
+	if (m_retraceChanged) sRetraceChanged(scene);
+	else if (m_rayTree.isRecording() && !m_rayTree.hasScene()) m_rayTree.setScene(std::move(scene));
 
 
 	int maxCount = 15; // max amount of operations in 1 frame e.g. reflection/ refraction
@@ -589,6 +1254,7 @@ void Simulation::sCollisionv2()
 	int N = m_buffers.currRayCount; // Current number of rays to process
 
 //	std::cout << "PRE-PROCESSING: " << preProcessingClock.getElapsedTime().asMilliseconds() << " ms\n";
+	m_traceProfiler.add(TraceProfiler::Stage::Setup, preProcessingClock.getElapsedTime().asSeconds());
 
 	while (count < maxCount )
 	{
@@ -597,6 +1263,10 @@ void Simulation::sCollisionv2()
 
 		std::vector<float> prevRayX(N);
 		std::vector<float> prevRayY(N);
+		// The kernel overwrites the directions and indices in place, so keep each ray as it was launched for the tree, or for splitting a bundle
+		const bool recordTree = m_rayTree.isRecording();
+		const bool keepLaunched = recordTree || m_lazyDispersion;
+		std::vector<RayData> launched(keepLaunched ? N : 0);
 
 		// Store current ray origins before kernel modifies them
 		for (int i = 0; i < N; ++i)
@@ -605,47 +1275,30 @@ void Simulation::sCollisionv2()
 			// Otherwise we would see gaps when zooming in 
 			prevRayX[i] = m_buffers.rayOriginsX[i] - m_buffers.rayDirsX[i];
 			prevRayY[i] = m_buffers.rayOriginsY[i] - m_buffers.rayDirsY[i];
+			if (keepLaunched)
+			{
+				RayData& ray = launched[i];
+				ray.originX = m_buffers.rayOriginsX[i];
+				ray.originY = m_buffers.rayOriginsY[i];
+				ray.dirX = m_buffers.rayDirsX[i];
+				ray.dirY = m_buffers.rayDirsY[i];
+				ray.finished = false;
+				ray.whiteLight = m_buffers.whiteLight[i];
+				ray.refracIndex = m_buffers.refracIndices[i];
+				ray.color = m_buffers.rayColours[i];
+				ray.wavelength = m_buffers.wavelengths[i];
+				ray.intensity = m_buffers.rayIntensities[i];
+				ray.parent = m_buffers.rayParents[i];
+				ray.source = m_buffers.raySources[i];
+				ray.wavelengthSpan = m_buffers.wavelengthSpans[i];
+				ray.bundle = m_buffers.rayBundles[i];
+				ray.bundleRole = m_buffers.rayBundleRoles[i];
+			}
 		}
-		sf::Clock GPUClock;
-		
-		Kernel ray_edge_intersection(
-			m_device, N, "ray_fresnel_mode",
-			m_buffers.rayOriginsX, m_buffers.rayOriginsY,
-			m_buffers.rayDirsX, m_buffers.rayDirsY,
-			m_buffers.reflectedRayDirsX, m_buffers.reflectedRayDirsY,
-			m_buffers.edgeA_X, m_buffers.edgeA_Y,
-			m_buffers.edgeB_X, m_buffers.edgeB_Y,
-			m_buffers.edgeEntityIndices, edgeCount,
-			m_buffers.collisionPointsX, m_buffers.collisionPointsY, m_buffers.entityIndexHit,
-			m_buffers.refracIndices, m_buffers.whiteLight,
-			m_buffers.finishedProcessing, m_buffers.screenBounds, m_buffers.transmissionCoefficients, m_buffers.sellmeierCoefficientsA, m_buffers.sellmeierCoefficientsB,
-			m_buffers.entitySellmeierProfiles, m_buffers.wavelengths
-		);
-
-		// WRITE ALL DATA
-		m_buffers.rayOriginsX.write_to_device(0,N);
-		m_buffers.rayOriginsY.write_to_device(0,N);
-		m_buffers.rayDirsX.write_to_device(0,N);
-		m_buffers.rayDirsY.write_to_device(0,N);
-		m_buffers.refracIndices.write_to_device(0,N);
-		m_buffers.wavelengths.write_to_device(0, N);
-		m_buffers.whiteLight.write_to_device(0, N);
-
-		// Run the kernel to process ray-entity intersections
-		ray_edge_intersection.run();
-
-		// Read back results
-		// Might remove these false don't think they make a difference
-		m_buffers.rayDirsX.read_from_device(0,N,false);
-		m_buffers.rayDirsY.read_from_device(0,N,false);
-		m_buffers.collisionPointsX.read_from_device(0,N,false);
-		m_buffers.collisionPointsY.read_from_device(0,N,false);
-		// We don't use entityIndexHit yet but we might in the future e.g. if we want to only update certain rays if the movement of an entity doesn't effect them
-		m_buffers.entityIndexHit.read_from_device(0,N,false);
-		m_buffers.transmissionCoefficients.read_from_device(0, N, false);
-		m_buffers.reflectedRayDirsX.read_from_device(0, N, false);
-		m_buffers.reflectedRayDirsY.read_from_device(0, N, false);
-		m_buffers.finishedProcessing.read_from_device(0,N);
+		sf::Clock kernelClock;
+		sTraceGeneration(N, edgeCount);
+		m_traceProfiler.add(TraceProfiler::Stage::Kernel, kernelClock.getElapsedTime().asSeconds());
+		m_traceProfiler.addRays(N);
 		
 
 		// std::cout << "GPU processing time: " << GPUClock.getElapsedTime().asMilliseconds() << " ms\n";
@@ -664,8 +1317,20 @@ void Simulation::sCollisionv2()
 			};
 		
 		sf::Clock postProcessingClock;
+		// Rays of each dispersion bundle by role, indexed by bundle number
+		std::vector<std::array<int, 3>> bundles;
+		std::uint32_t nextBundle = 0; // Numbers the next generation's bundles
 		for (int i = 0; i < N; i++)
 		{
+			// Bundles are dealt with as a whole once every ray in them has been gathered, see below
+			if (m_buffers.rayBundles[i] != noBundle)
+			{
+				const std::uint32_t bundle = m_buffers.rayBundles[i];
+				if (bundle >= bundles.size()) bundles.resize(bundle + 1, { -1, -1, -1 });
+				bundles[bundle][m_buffers.rayBundleRoles[i]] = i;
+				continue;
+			}
+
 			// Calculate new dimmed colour
 			float transmission = m_buffers.transmissionCoefficients[i];
 			sf::Color rayColour = m_buffers.rayColours[i];
@@ -673,6 +1338,20 @@ void Simulation::sCollisionv2()
 			allRays.append(sf::Vertex{ sf::Vector2f(prevRayX[i], prevRayY[i]), rayColour});
 			allRays.append(sf::Vertex{ sf::Vector2f(m_buffers.collisionPointsX[i], m_buffers.collisionPointsY[i]), rayColour });
 
+			// Every child of this ray points back at its node so a change can find everything downstream of it
+			std::uint32_t node = RayTree::noParent;
+			if (recordTree)
+			{
+				RayTree::Node traced{ launched[i], sf::Vector2f(prevRayX[i], prevRayY[i]), sf::Vector2f(m_buffers.collisionPointsX[i], m_buffers.collisionPointsY[i]) };
+				int hit = m_buffers.entityIndexHit[i];
+				if (hit >= 0 && hit < static_cast<int>(prismEntities.size()) && prismEntities[hit] != nullptr)
+				{
+					traced.hitEntity = prismEntities[hit]->getID();
+					traced.hitDetector = prismEntities[hit]->m_isDetector;
+				}
+				node = m_rayTree.add(traced, launched[i].parent);
+			}
+
 			if (!m_buffers.finishedProcessing[i])
 			{   // If not finished processing, update the data about it
 				int entityIndex = m_buffers.entityIndexHit[i];
@@ -722,6 +1401,8 @@ void Simulation::sCollisionv2()
 					reflectedRayData.whiteLight = m_buffers.whiteLight[i];
 					reflectedRayData.color = newColour;
 					reflectedRayData.wavelength = m_buffers.wavelengths[i];
+					reflectedRayData.intensity = m_buffers.rayIntensities[i] * loss;
+					reflectedRayData.parent = node;
 					m_buffers.createRay(reflectedRayData);
 					continue; 
 				}
@@ -748,6 +1429,8 @@ void Simulation::sCollisionv2()
 						reflectedRayData.whiteLight = m_buffers.whiteLight[i];
 						reflectedRayData.color = reflectedColour;
 						reflectedRayData.wavelength = m_buffers.wavelengths[i];
+						reflectedRayData.intensity = m_buffers.rayIntensities[i] * (1.0f - transmission);
+						reflectedRayData.parent = node;
 						m_buffers.createRay(reflectedRayData);
 					}
 					else
@@ -774,6 +1457,8 @@ void Simulation::sCollisionv2()
 				transmittedRayData.whiteLight = m_buffers.whiteLight[i];
 				transmittedRayData.color = transmittedColour;
 				transmittedRayData.wavelength = m_buffers.wavelengths[i];
+				transmittedRayData.intensity = m_buffers.rayIntensities[i] * transmission;
+				transmittedRayData.parent = node;
 
 				m_buffers.createRay(transmittedRayData);
 			}
@@ -791,9 +1476,7 @@ void Simulation::sCollisionv2()
 					float dirY = m_buffers.rayDirsY[i];
 					float originX = m_buffers.collisionPointsX[i] - dirX;
 					float originY = m_buffers.collisionPointsY[i] - dirY;
-					for (const auto& [wavelength, colour] : wavelengthColors) 
-					{
-
+					auto splitRay = [&](float wavelength, const sf::Color& colour, float intensity) {
 						RayData rayData;
 						rayData.originX = originX;
 						rayData.originY = originY;
@@ -802,10 +1485,134 @@ void Simulation::sCollisionv2()
 						rayData.whiteLight = false;
 						rayData.color = colour;
 						rayData.wavelength = wavelength; 
-						m_buffers.createRay(rayData);
+						rayData.intensity = intensity;
+						rayData.parent = node;
+						// Every ray of the fan starts just before the edge the white ray hit, so the kernel only has to test that edge
+						rayData.knownEdge = m_buffers.hitEdges[i];
+						return rayData;
+						};
+					if (m_heroWavelengths)
+					{
+						// Hero wavelength plus rotations by a 1/count of the spectrum, jittered within this pass's slice of each of those strata
+						// so between them the passes cover the whole spectrum evenly
+						const float range = m_endWavelength - m_startWavelength;
+						const float jitter = (m_spectralPass + std::uniform_real_distribution<float>(0.0f, 1.0f)(m_spectralRng)) / m_spectralPasses;
+						const float intensity = m_buffers.rayIntensities[i] / static_cast<float>(m_heroWavelengthCount);
+						for (int k = 0; k < m_heroWavelengthCount; ++k)
+						{
+							const float wavelength = m_startWavelength + range * (k + jitter) / m_heroWavelengthCount;
+							m_buffers.createRay(splitRay(wavelength, wavelengthToRGB(wavelength), intensity));
+						}
 					}
+					else if (m_lazyDispersion)
+					{
+						// One bundle for the whole spectrum, it's only split up where it fans out
+						std::array<RayData, 3> bundle = {
+							splitRay(0.5f * (m_startWavelength + m_endWavelength), bandColour(m_startWavelength, m_endWavelength), m_buffers.rayIntensities[i]),
+							splitRay(m_startWavelength, sf::Color::Transparent, 0.0f),
+							splitRay(m_endWavelength, sf::Color::Transparent, 0.0f)
+						};
+						bundle[0].wavelengthSpan = m_endWavelength - m_startWavelength;
+						stageBundle(bundle, nextBundle);
+					}
+					else
+					{
+						// The white ray's energy is shared out between the wavelengths it splits into
+						float intensity = m_buffers.rayIntensities[i] / static_cast<float>(wavelengthColors.size());
+						for (const auto& [wavelength, colour] : wavelengthColors) 
+						{
+							m_buffers.createRay(splitRay(wavelength, colour, intensity));
+						}
+					}
+
+				}
+			}
+		}
+
+		// ---- Dispersion bundles: carry on as one while the probes keep up with the centre, otherwise trace the segment again in pieces ----
+		const float bundleBrightnessThreshold = 0.5f; // Same as single rays
+		for (const std::array<int, 3>& bundle : bundles)
+		{
+			const int c = bundle[0];
+			if (c < 0) continue;
+			const sf::Color rayColour = m_buffers.rayColours[c];
+			const int entityIndex = m_buffers.entityIndexHit[c];
+			const bool hitEntity = entityIndex >= 0 && entityIndex < static_cast<int>(prismEntities.size()) && prismEntities[entityIndex] != nullptr;
+			auto drawCentre = [&]() {
+				allRays.append(sf::Vertex{ sf::Vector2f(prevRayX[c], prevRayY[c]), rayColour });
+				allRays.append(sf::Vertex{ sf::Vector2f(m_buffers.collisionPointsX[c], m_buffers.collisionPointsY[c]), rayColour });
+				};
+
+			// A detector has already counted the centre and there's no taking it back, and without both probes there's nothing to split by
+			if (bundle[1] < 0 || bundle[2] < 0 || (hitEntity && prismEntities[entityIndex]->m_isDetector))
+			{
+				drawCentre();
+				continue;
+			}
+
+			bool together = true;
+			float separation = 0.0f;
+			for (int k = 1; k < 3; ++k)
+			{
+				const int p = bundle[k];
+				separation = std::max(separation, std::hypot(m_buffers.collisionPointsX[p] - m_buffers.collisionPointsX[c], m_buffers.collisionPointsY[p] - m_buffers.collisionPointsY[c]));
+				together = together && m_buffers.finishedProcessing[p] == m_buffers.finishedProcessing[c] && m_buffers.entityIndexHit[p] == entityIndex;
+				// Total internal reflection for part of the band
+				together = together && (m_buffers.finishedProcessing[c] || (m_buffers.transmissionCoefficients[p] == 0.0f) == (m_buffers.transmissionCoefficients[c] == 0.0f));
+			}
+			if (!together || separation > m_dispersionTolerance)
+			{
+				splitBundle({ launched[c], launched[bundle[1]], launched[bundle[2]] }, separation, nextBundle);
+				continue;
+			}
+
+			drawCentre();
+			if (m_buffers.finishedProcessing[c] || !hitEntity) continue;
+
+			// Every ray of the bundle takes the branch the centre takes, each with its own direction
+			const float transmission = m_buffers.transmissionCoefficients[c];
+			const bool reflectOnly = prismEntities[entityIndex]->m_isMirror || transmission == 0.0f;
+			auto branch = [&](bool reflected, float share, const sf::Color& colour) {
+				std::array<RayData, 3> next;
+				for (int k = 0; k < 3; ++k)
+				{
+					const int r = bundle[k];
+					RayData& ray = next[k];
+					ray.dirX = reflected ? m_buffers.reflectedRayDirsX[r] : m_buffers.rayDirsX[r];
+					ray.dirY = reflected ? m_buffers.reflectedRayDirsY[r] : m_buffers.rayDirsY[r];
+					ray.originX = m_buffers.collisionPointsX[r] + ray.dirX;
+					ray.originY = m_buffers.collisionPointsY[r] + ray.dirY;
+					ray.finished = false;
+					ray.refracIndex = reflectOnly ? 1.0f : m_buffers.refracIndices[r];
+					ray.color = colour;
+					ray.wavelength = m_buffers.wavelengths[r];
+					ray.wavelengthSpan = m_buffers.wavelengthSpans[r];
+					ray.intensity = m_buffers.rayIntensities[c] * share;
 				}
+				stageBundle(next, nextBundle);
+				};
+			if (reflectOnly)
+			{
+				if (computeBrightness(rayColour) >= bundleBrightnessThreshold) branch(true, 1.0f, rayColour);
+				continue;
 			}
+			const sf::Color reflectedColour = scaleColor(rayColour, 1.0f - transmission);
+			const sf::Color transmittedColour = scaleColor(rayColour, transmission);
+			if (m_buffers.reflectedRayDirsX[c] != 0.0f && m_buffers.reflectedRayDirsY[c] != 0.0f && computeBrightness(reflectedColour) > bundleBrightnessThreshold)
+			{
+				branch(true, 1.0f - transmission, reflectedColour);
+			}
+			if (computeBrightness(transmittedColour) >= bundleBrightnessThreshold) branch(false, transmission, transmittedColour);
+		}
+
+		m_traceProfiler.add(TraceProfiler::Stage::PostProcess, postProcessingClock.getElapsedTime().asSeconds());
+
+		// Put the next generation in spatial and directional order so neighbouring work items do similar work
+		if (m_sortRays)
+		{
+			sf::Clock sortClock;
+			m_buffers.sortStagedRays();
+			m_traceProfiler.add(TraceProfiler::Stage::Sort, sortClock.getElapsedTime().asSeconds());
 		}
 
 		// Final count of rays for next iteration
@@ -819,10 +1626,164 @@ void Simulation::sCollisionv2()
 		//std::cout << "Post processing time: " << postProcessingClock.getElapsedTime().asMilliseconds() << " ms\n";
 		count++;
 	}
+
+	// Read the histograms back after every frame's worth of tracing rather than waiting for every ray to finish,
+	// rays stuck bouncing between mirrors would otherwise mean the detectors never show anything
+	m_detectorCount = detectorCount;
+	if (detectorCount > 0)
+	{
+		m_buffers.detectorHistogram.read_from_device(0, detectorCount * RayCollisionBuffers::detectorPositionBins * RayCollisionBuffers::detectorWavelengthBins);
+		m_traceScheduler.gatherDetectors(m_buffers, detectorCount);
+	}
+	if (m_buffers.currRayCount == 0)
+	{
+		m_traceProfiler.finish();
+	}
 	//std::cout << "Collision processing time: " << collisionClock.getElapsedTime().asMilliseconds() << " ms\n";
 }
 
 
+std::string Simulation::sceneKernelVariant(const std::vector<int>& sellmeierIndices, size_t entityCount) const
+{
+	// ---- What the entities the kernel can hit are made of ----
+	bool hasMirrors = false;
+	bool hasDetectors = false;
+	std::vector<int> materials;
+	for (size_t i = 0; i < entityCount && i < sellmeierIndices.size(); ++i)
+	{
+		int profile = sellmeierIndices[i];
+		if (profile == -1) hasMirrors = true;
+		else if (profile <= -2) hasDetectors = true;
+		else if (std::find(materials.begin(), materials.end(), profile) == materials.end()) materials.push_back(profile);
+	}
+
+	// ---- White light only ever comes from a light source, every ray split off it is a single wavelength or a dispersion bundle ----
+	bool hasWhiteLight = false;
+	for (size_t i = 0; i < m_lightSources.size() && !hasWhiteLight; ++i)
+	{
+		hasWhiteLight = m_lightSources.data()[i].whiteLight;
+	}
+	for (size_t i = 0; i < m_emitters.size() && !hasWhiteLight; ++i)
+	{
+		hasWhiteLight = m_emitters.data()[i].whiteLight;
+	}
+
+	std::string defines;
+	if (!hasDetectors) defines += "\n#define NO_DETECTORS";
+	if (!hasMirrors) defines += "\n#define NO_MIRRORS";
+	if (hasMirrors && materials.empty()) defines += "\n#define MIRRORS_ONLY";
+	if (materials.size() == 1) defines += "\n#define SINGLE_MATERIAL " + std::to_string(materials[0]);
+	if (!hasWhiteLight) defines += "\n#define NO_WHITE_LIGHT";
+	return defines;
+}
+
+void Simulation::sTraceGeneration(uint N, int edgeCount)
+{
+	const uint H = std::min<uint>(m_buffers.hostRayCount, N);
+	const std::vector<TraceScheduler::Slice> slices = m_traceScheduler.partition(N);
+	if (slices.size() == 1)
+	{
+		traceSlice(m_device, m_buffers, N, H, edgeCount);
+		return;
+	}
+
+	// Every slice covers its own range of the host buffers so they can all run at once. Emitter rays generated on the main
+	// device are there too, sEmitRays copies them back
+	std::vector<std::future<void>> secondaryTraces;
+	for (size_t i = 1; i < slices.size(); ++i)
+	{
+		const TraceScheduler::Slice slice = slices[i];
+		secondaryTraces.push_back(std::async(std::launch::async, [this, slice, edgeCount]() {
+			RayCollisionBuffers& buffers = *slice.secondary->buffers;
+			sf::Clock clock;
+			buffers.copyRayInputsFrom(m_buffers, slice.offset, slice.count);
+			traceSlice(*slice.secondary->device, buffers, slice.count, slice.count, edgeCount);
+			buffers.copyRayResultsTo(m_buffers, slice.offset, slice.count);
+			m_traceScheduler.recordTiming(slice.secondary, slice.count, clock.getElapsedTime().asSeconds());
+			}));
+	}
+
+	const uint primaryCount = slices[0].count;
+	sf::Clock clock;
+	traceSlice(m_device, m_buffers, primaryCount, std::min(H, primaryCount), edgeCount);
+	m_traceScheduler.recordTiming(nullptr, primaryCount, clock.getElapsedTime().asSeconds());
+
+	for (std::future<void>& trace : secondaryTraces)
+	{
+		trace.get();
+	}
+}
+
+void Simulation::traceSlice(Device& device, RayCollisionBuffers& buffers, uint N, uint uploadCount, int edgeCount)
+{
+	if (N == 0) return;
+	device.use_variant(device.is_variant_ready(m_kernelVariant) ? m_kernelVariant : "");
+	const std::string kernelName = m_tileEdges ? "ray_fresnel_mode_tiled" : "ray_fresnel_mode";
+	const LaunchConfig launch = m_launchTuner.next(device, kernelName, N);
+	const uint chunkSize = launch.chunkSize > 0 ? std::min(launch.chunkSize, N) : N;
+	Kernel ray_edge_intersection(
+		device, launch.globalRange(chunkSize), launch.workgroupSize, kernelName,
+		buffers.rayOriginsX, buffers.rayOriginsY,
+		buffers.rayDirsX, buffers.rayDirsY,
+		buffers.reflectedRayDirsX, buffers.reflectedRayDirsY,
+		buffers.edgeA_X, buffers.edgeA_Y,
+		buffers.edgeB_X, buffers.edgeB_Y,
+		buffers.edgeEntityIndices, edgeCount,
+		buffers.collisionPointsX, buffers.collisionPointsY, buffers.entityIndexHit,
+		buffers.refracIndices, buffers.whiteLight,
+		buffers.finishedProcessing, buffers.worldBounds, buffers.transmissionCoefficients, buffers.sellmeierCoefficientsA, buffers.sellmeierCoefficientsB,
+		buffers.entitySellmeierProfiles, buffers.wavelengths,
+		0u, chunkSize, buffers.rayIntensities, buffers.detectorHistogram,
+		RayCollisionBuffers::detectorPositionBins, RayCollisionBuffers::detectorWavelengthBins,
+		m_startWavelength, m_endWavelength, RayCollisionBuffers::detectorEnergyScale,
+		buffers.wavelengthSpans, buffers.knownEdges, buffers.hitEdges,
+		buffers.refractiveIndexTable, RayCollisionBuffers::indexTableSize, m_startWavelength, m_endWavelength
+	);
+
+	// WRITE ALL DATA
+	// Rays generated by emitters are already on the device so only the ones made on the host need sending
+	if (uploadCount > 0)
+	{
+		buffers.rayOriginsX.write_to_device(0, uploadCount);
+		buffers.rayOriginsY.write_to_device(0, uploadCount);
+		buffers.rayDirsX.write_to_device(0, uploadCount);
+		buffers.rayDirsY.write_to_device(0, uploadCount);
+		buffers.refracIndices.write_to_device(0, uploadCount);
+		buffers.wavelengths.write_to_device(0, uploadCount);
+		buffers.whiteLight.write_to_device(0, uploadCount);
+		buffers.rayIntensities.write_to_device(0, uploadCount);
+		buffers.wavelengthSpans.write_to_device(0, uploadCount);
+		buffers.knownEdges.write_to_device(0, uploadCount);
+	}
+
+	// Run the kernel to process ray-entity intersections, one chunk of rays at a time if the tuner found that faster
+	sf::Clock kernelClock;
+	for (uint first = 0; first < N; first += chunkSize)
+	{
+		const uint end = std::min(N, first + chunkSize);
+		ray_edge_intersection.set_parameters(firstRayArgument, first, end);
+		ray_edge_intersection.set_ranges(launch.globalRange(end - first), launch.workgroupSize);
+		ray_edge_intersection.enqueue_run();
+	}
+	ray_edge_intersection.finish_queue();
+	m_launchTuner.report(device, kernelName, launch, N, edgeCount, kernelClock.getElapsedTime().asSeconds());
+
+	// Read back results
+	// Might remove these false don't think they make a difference
+	buffers.rayDirsX.read_from_device(0, N, false);
+	buffers.rayDirsY.read_from_device(0, N, false);
+	buffers.collisionPointsX.read_from_device(0, N, false);
+	buffers.collisionPointsY.read_from_device(0, N, false);
+	// entityIndexHit tells the host which entity each ray hit so it knows what to spawn next
+	buffers.entityIndexHit.read_from_device(0, N, false);
+	buffers.transmissionCoefficients.read_from_device(0, N, false);
+	buffers.reflectedRayDirsX.read_from_device(0, N, false);
+	buffers.reflectedRayDirsY.read_from_device(0, N, false);
+	buffers.hitEdges.read_from_device(0, N, false);
+	buffers.finishedProcessing.read_from_device(0, N);
+}
+
+
 // Clamp a value between min and max	
 double Simulation::clamp(double value, double min, double max) {
 	return std::max(min, std::min(max, value));
@@ -947,18 +1908,9 @@ void Simulation::toggleFullscreen() {
 	ImGui::SFML::Init(m_window);  // Re-init ImGui with new window
 }
 
-void Simulation::sRemoveRay(RayData* ray)
+void Simulation::sRemoveRay(SlotHandle ray)
 {
-	if (!ray) return;
-	// Find the index of the ray in the m_lightSources vector
-	auto it = std::find_if(m_lightSources.begin(), m_lightSources.end(),
-		[ray](const std::unique_ptr<RayData>& r) {
-			return r.get() == ray;
-		});
-	if (it != m_lightSources.end()) {
-		// std::cout << " REMOVING RAY \n";
-		m_lightSources.erase(it);  // Remove the ray from the vector
-	}
+	m_lightSources.remove(ray);
 }
 
 void Simulation::sUpdateWavelengthCreation()
@@ -987,15 +1939,16 @@ void Simulation::sUpdateWavelengthCreation()
 	}
 	m_stateChange = true;
 	sf::Color color = wavelengthToRGB(m_wavelengthCreation);
-	for (auto& e : m_entities.getEntities())
+	for (auto& [marker, e] : m_entities.components<CMarker>())
 	{
-		if (e->getTag() == "Marker" && e->cMarker &&
-			e->cMarker->getRole() == MarkerRole::ColouredPointLightMarker)
+		if (e->getTag() == "Marker" &&
+			marker.getRole() == MarkerRole::ColouredPointLightMarker)
 		{
-			for (RayData* ray : e->cMarker->getRays())
+			if (Emitter* emitter = m_emitters.get(marker.getTargetEmitter()))
 			{
-				color.a = ray->color.a; // maintain alpha
-				ray->color = color;
+				color.a = emitter->color.a; // maintain alpha
+				emitter->color = color;
+				emitter->wavelength = m_wavelengthCreation;
 			}
 		}
 	}
@@ -2,6 +2,7 @@
 #include <SFML/Graphics.hpp>
 #include <optional>
 #include <map>
+#include <random>
 #include "EntityManager.h"
 #include "RayManager.h"
 #include "Vec2fExtension.h"
@@ -16,6 +17,13 @@
 #include "PrismDemo.h"
 #include "CustomPolygonPrism.h"
 #include "CirularArcShape.h"
+#include "DetectorShape.h"
+#include "SlotMap.h"
+#include "TraceScheduler.h"
+#include "LaunchTuner.h"
+#include "TraceProfiler.h"
+#include "RayTree.h"
+#include "SegmentIndex.h"
 
 class Simulation {
 	// Window stuff
@@ -30,17 +38,56 @@ class Simulation {
 	// OpenCL stuff
 	Device m_device;
 	RayCollisionBuffers m_buffers;
-	std::vector<std::unique_ptr<RayData>> m_lightSources;
+	// Hands slices of each ray generation to the other OpenCL devices when "Use All Devices" is on
+	TraceScheduler m_traceScheduler;
+	// Work group size, rays per work item and chunk size for each kernel on each device, swept the first time and saved to disk
+	LaunchTuner m_launchTuner;
+	// Trace with ray_fresnel_mode_tiled, which shares each edge between a work group through local memory. Off by default so the two can be compared
+	bool m_tileEdges = false;
+	// Sort each new generation of rays by origin and direction before it's traced
+	bool m_sortRays = false;
+	// Compile ray_fresnel_mode without the branches the scene can't take (mirrors, detectors, white light, more than one glass)
+	bool m_specialiseKernels = true;
+	std::string m_kernelVariant; // The #define lines for the current scene, "" is the generic kernel
+	std::uint64_t m_uploadedMaterials = 0; // Hash of the material version and spectrum the device's coefficients and index tables were made from
+	// Where the time went in the last finished trace, shown in Other > Profiler
+	TraceProfiler m_traceProfiler;
+	// Keep every segment of the last trace with the ray that spawned it, so moving an entity only re-traces the rays it could have changed
+	bool m_incrementalTracing = true;
+	RayTree m_rayTree;
+	bool m_retraceChanged = false; // Set by sHandleStateChange, sCollisionv2 works out what changed once it has the entities' edges
+	// Light sources are held by handle (markers, demo prisms) and streamed into the ray buffers every retrace
+	SlotMap<RayData> m_lightSources;
+	SlotMap<Emitter> m_emitters;
+	Emitter m_emitterSettings; // What the next placed emitter will look like, set in the Light Source menu
 
 	// VertexArray for every single ray in the simulation
 	sf::VertexArray allRays = sf::VertexArray(sf::PrimitiveType::Lines);
 
+	// Once the trace has converged allRays is rendered into this once and then just blitted each frame
+	sf::RenderTexture m_rayLayer;
+	sf::View m_rayLayerView;
+	bool m_rayLayerDirty = true;
+	// Grid over allRays once the trace has converged, so the layer and screenshots only draw the segments in view
+	SegmentIndex m_rayIndex;
+	sf::VertexArray m_visibleRays = sf::VertexArray(sf::PrimitiveType::Lines);
+	bool m_rayIndexDirty = true;
+
 	// Manage these things
 	EntityManager m_entities;
 	SellmeierManager m_sellmeierManager;
 
 	// Stored for a variety of things, just search the variable in UserInput.cpp if want to see
 	sf::Vector2i m_lastMousePos;
+	sf::Vector2f m_lastMouseWorldPos;
+
+	// Rays that miss everything stop at the edge of this box, set in Other > World Bounds. It doesn't follow the view so navigating never re-traces
+	sf::FloatRect m_worldBounds = sf::FloatRect({ -20000.0f, -20000.0f }, { 40000.0f, 40000.0f });
+
+	// ---- Curve tessellation ----
+	float m_maxChordError = defaultMaxChordError; // World units, the furthest a curve's edges may be from the true curve
+	bool m_zoomAwareTessellation = false;         // Also keep the error under m_maxChordErrorPixels on screen
+	float m_maxChordErrorPixels = 0.25f;
 
 	// Essential constants
 	int m_pointLightResolution = 10; // Number of rays created when a point light is created
@@ -51,6 +98,28 @@ class Simulation {
 	float m_step = (m_endWavelength - m_startWavelength) / (prismResolution - 1); // Subtract 1 to ensure correct number of steps
 	float m_wavelengthCreationStep = 0.0f; // Step size for wavelength slider
 
+	// ---- Hero wavelength sampling ----
+	// Rather than splitting white light into every wavelength at once, each white ray splits into a few evenly spaced wavelengths from a random hero one.
+	// The converged trace then gets another pass with them moved along, until m_spectralPasses passes have been drawn on top of each other
+	bool m_heroWavelengths = false;
+	int m_heroWavelengthCount = 4;
+	int m_spectralPasses = 64;
+	int m_spectralPass = 0;
+	std::mt19937 m_spectralRng{ std::random_device{}() };
+
+	// ---- Lazy dispersion ----
+	// White light hitting glass becomes one bundle standing in for the whole spectrum, traced as a centre ray plus a probe ray at each end of its band.
+	// A bundle is only split, from where its last segment started, once a probe ends up more than m_dispersionTolerance from the centre or goes a different way,
+	// so the spectrum only gets divided up where it actually fans out. Bands narrower than minBundleSteps wavelengths are split into every wavelength they hold
+	bool m_lazyDispersion = false;
+	float m_dispersionTolerance = 1.0f; // World units
+	static constexpr int maxBundleSplit = 16;
+	static constexpr int minBundleSteps = 8;
+	std::vector<std::pair<float, sf::Color>> m_spectrum; // wavelengthColors in order of wavelength
+	static constexpr std::uint32_t noBundle = UINT32_MAX;
+
+	// Number of detectors in the last trace, their histograms are in m_buffers.detectorHistogram and refreshed after every sCollisionv2
+	uint m_detectorCount = 0;
 
 	// Stores all the wavelengths and their colours
 	std::unordered_map<float,sf::Color> wavelengthColors;
@@ -60,6 +129,7 @@ class Simulation {
 	Entity* m_selectedEntity = nullptr;
 	Entity* m_rotator = nullptr;
 	Entity* m_circularArcInProgress = nullptr;
+	Entity* m_detectorInProgress = nullptr;
 	sf::Vector2f m_dragOffset;
 
 	// Bool flags for a variety of things
@@ -75,6 +145,9 @@ class Simulation {
 	bool m_placingSingleRay = false; 
 	bool m_placingCircularArc = false;
 	bool m_placingLineMirror = false;
+	bool m_placingDetector = false;
+	bool m_placingEmitter = false;
+	bool m_showDetectorReadout = false;
 	bool m_isFullscreen = false;
 	bool m_wavelengthIncreasing = true; // For the wavelength creation slider
 
@@ -85,8 +158,8 @@ class Simulation {
 	// Updates m_wavelengthCreation based on m_wavelengthCreationStep.
 	void sUpdateWavelengthCreation();
 
-	// Removes a ray from m_lightSources.
-	void sRemoveRay(RayData* ray);
+	// Removes a ray from m_lightSources, stale handles are ignored.
+	void sRemoveRay(SlotHandle ray);
 
 	// Toggles fullscreen mode.
 	void toggleFullscreen();
@@ -94,15 +167,73 @@ class Simulation {
 	// Main logic of the simulation, sends data to the GPU, processes ray-entity intersections, and updates the rays.
 	void sCollisionv2();
 
+	// The #define lines that specialise the trace kernel to the entities in this trace, see the #ifdefs in kernel.cpp.
+	std::string sceneKernelVariant(const std::vector<int>& sellmeierIndices, size_t entityCount) const;
+
+	// Traces one generation of N rays, split across every device m_traceScheduler has if it's turned on.
+	void sTraceGeneration(uint N, int edgeCount);
+
+	// Runs ray_fresnel_mode over the first N rays of buffers on device, uploading the first uploadCount from the host first and reading every result back.
+	void traceSlice(Device& device, RayCollisionBuffers& buffers, uint N, uint uploadCount, int edgeCount);
+	// Where firstRay sits in ray_fresnel_mode's (and the tiled version's) arguments, rayEnd is the one after it
+	static constexpr uint firstRayArgument = 24;
+
 	// Handles rendering of the simulation, draws all entities and rays.
 	void sRender();
 
-	// Handles state changes, such as when a new entity is created or an entity is moved. It simply restarts m_buffers and populates it with light sources.
+	// Re-renders allRays into m_rayLayer if the rays, view or window size have changed since it was last drawn.
+	void sUpdateRayLayer();
+
+	// The segments of allRays that can be seen through view, rebuilding m_rayIndex first if the rays have changed. Just allRays while still tracing.
+	const sf::VertexArray& visibleRays(const sf::View& view);
+
+	// Handles state changes, such as when a new entity is created or an entity is moved.
+	// A finished trace is patched by sRetraceChanged if incremental tracing is on, otherwise it starts again with sRestartTrace.
 	void sHandleStateChange();
 
+	// Clears every ray and refills m_buffers with the light sources.
+	void sRestartTrace();
+
+	// Throws away the rays the entities that changed since the last trace could have affected and queues them to be traced again,
+	// along with every ray of a light source or emitter that changed, which are emitted again on their own.
+	// Falls back to sRestartTrace if the world bounds or materials changed or a detector counted one of the rays.
+	void sRetraceChanged(const RayTree::Scene& scene);
+
+	// Hash of everything apart from the entities and light sources that a trace depends on, the ray tree is only reused while this stays the same.
+	std::uint64_t traceInputsSignature();
+
+	// Every light source and emitter with a hash of its settings, so the ray tree can tell which ones moved.
+	RayTree::Sources traceSources() const;
+
+	// Hero wavelength mode: emits the white light sources again for the next pass over a converged trace, the last passes' rays are kept.
+	void sEmitSpectralPass();
+
+	// Scales the intensity of the white rays in [first, end) by share, so each hero wavelength pass carries its share of the light.
+	void shareWhiteLight(uint first, uint end, float share);
+
+	// Fills in the Sellmeier coefficients and n(wavelength) table of every material and sends them to the device.
+	void uploadMaterials();
+
+	// Lazy dispersion: the brightest of each channel over the wavelengths in [shortest, longest], which is what all of them drawn on top of each other blends to.
+	sf::Color bandColour(float shortest, float longest) const;
+
+	// Queues a bundle's centre, short and long rays for the next generation under a new bundle number.
+	void stageBundle(std::array<RayData, 3> rays, std::uint32_t& nextBundle);
+
+	// Traces a bundle's last segment again as narrower bundles, or as every wavelength in its band once it's narrow enough.
+	// launched is the centre, short and long ray as they started the segment, the ones in between are interpolated from them.
+	void splitBundle(const std::array<RayData, 3>& launched, float separation, std::uint32_t& nextBundle);
+
+	// Expands every emitter into rays directly in the device buffers, appended after the rays already committed.
+	void sEmitRays();
+	void sEmitRays(const std::vector<SlotHandle>& emitters); // Just these ones, stale handles are skipped
+
 	// Updates the alpha value of a demoPrism shape if they exist.
 	void sUpdateAlpha();
 
+	// Re-tessellates lenses and arcs when the chord error (or the zoom, if zoom aware) changes.
+	void sUpdateTessellation();
+
 	// Updates rotator position based on the selected entity.
 	void updateRotatorPosition();
 
@@ -115,12 +246,21 @@ class Simulation {
 	// Initializes the simulation, creates the window, sets up ImGui
 	void init();
 
-	// Saves a screenshot, scale factor is used to increase the resolution of the screenshot.
+	// Saves a screenshot as a PNG, scale factor is used to increase the resolution of the screenshot.
+	// The trace is finished first (see finishTrace), then it is rendered and written a strip at a time so memory use doesn't grow with the scale factor.
 	void saveScreenshot(const std::string& filename, unsigned int scaleFactor = 10);
 
 	// Renders a screenshot of the current state of the simulation.
 	void sRenderScreenShot(sf::RenderTarget& target);
 
+	// Traces until the current trace has converged and, in hero wavelength mode, every spectral pass has been added to it,
+	// so a screenshot or exported frame has the whole spectrum rather than just the passes the live view had got to.
+	void finishTrace();
+
+	// Steps every animation (demo prism alpha, wavelength sweep) frameCount times as fast as the rays can be traced,
+	// each frame is traced to completion and written to directory as a numbered PNG on a worker thread.
+	void exportFrameSequence(const std::string& directory, int frameCount);
+
 	// Convert wavelength to RGB color
 	sf::Color wavelengthToRGB(double wavelength);
 
@@ -136,9 +276,11 @@ class Simulation {
 	void sCreateDemoPrism(const sf::Vector2f& position, const float width, const float angle, const sf::Color& fillColor, const sf::Color& borderColor, const std::string& material);
 	void sCreateLens(const sf::Vector2f&, const float, const float, const float, const float, const sf::Color&, const sf::Color&, const std::string&);
 	Entity* sCreateCircularArc(Entity* m1, Entity* m2, Entity* m3, const sf::Color& borderColour);
+	Entity* sCreateDetector(const sf::Color& colour);
 	Entity* sCreateMarker(const sf::Vector2f& position, const float radius, const int sides, const sf::Color& insideColor, const sf::Color& borderColor, const float rotationDeg);
-	RayData* sCreateWhiteRay(sf::Vector2f origin, sf::Vector2f dir);
-	RayData* sCreateColouredRay(sf::Vector2f origin, sf::Vector2f dir, float wavelength);
+	SlotHandle sCreateWhiteRay(sf::Vector2f origin, sf::Vector2f dir);
+	SlotHandle sCreateColouredRay(sf::Vector2f origin, sf::Vector2f dir, float wavelength);
+	SlotHandle sCreateEmitter(const Emitter& settings);
 
 
 	// ╔═════════════════════════════╗
@@ -151,6 +293,7 @@ class Simulation {
 	void handleMouseButtonReleased(const std::optional<sf::Event> event);
 	void handleMouseMoved(const std::optional<sf::Event> event);
 	void handleDragging(sf::Vector2f mouseWorldPos);
+	void sRefreshPickBounds(Entity* entity); // Re-index an entity and everything that moves with it for picking
 
 	// ╔═════════════════════════════════╗
 	// ║   "SimulationUI.cpp" functions  ║
@@ -160,8 +303,8 @@ public:
 	// Handles initialization and main loop of the simulation.
 	void run();
 	Simulation()
-		: m_device(select_device_with_most_flops()), m_windowedMode({ 1200,800 }),
-		m_buffers(m_device)
+		: m_device(select_device_with_most_flops(get_devices(false))), m_windowedMode({ 1200,800 }),
+		m_buffers(m_device), m_traceScheduler(m_device)
 		{}
 
 };
@@ -76,42 +76,27 @@ void Simulation::sGui()
 				if (ImGui::SliderInt("Resolution", &m_pointLightResolution, 4, 100000, "%d", ImGuiSliderFlags_AlwaysClamp))
 				{
 					m_stateChange = true;
-					for (auto& e : m_entities.getEntities())
+					for (auto& [marker, e] : m_entities.components<CMarker>())
 					{
-						if (e->getTag() == "Marker" && e->cMarker)
+						if (e->getTag() == "Marker")
 						{
-							bool isPoint = e->cMarker->getRole() == MarkerRole::PointLightMarker;
-							bool isColour = e->cMarker->getRole() == MarkerRole::ColouredPointLightMarker;
+							bool isPoint = marker.getRole() == MarkerRole::PointLightMarker;
+							bool isColour = marker.getRole() == MarkerRole::ColouredPointLightMarker;
 							if (!isPoint && !isColour) continue;
 
-							for (RayData* ray : e->cMarker->getRays()) sRemoveRay(ray);
-							e->cMarker->clearRays();
-							sf::Vector2f center = e->cShape->circle.getPosition();
+							Emitter* emitter = m_emitters.get(marker.getTargetEmitter());
+							if (!emitter) continue;
+							emitter->rayCount = m_pointLightResolution;
 
-							for (int i = 0; i < m_pointLightResolution; ++i)
+							if (isColour)
 							{
-								float angle = static_cast<float>(i) * (2 * pi / m_pointLightResolution);
-								sf::Vector2f dir = { std::cos(angle), std::sin(angle) };
-								sf::Vector2f rayOrigin = center + dir;
-
-								if (isPoint)
-								{
-									RayData* ray = sCreateWhiteRay(rayOrigin, dir);
-									e->cMarker->addTargetRay(ray);
-								}
-								else
-								{
-									RayData* ray = sCreateColouredRay(rayOrigin, dir, m_wavelengthCreation);
-									e->cMarker->addTargetRay(ray);
-
-									const int minRes = 5;
-									const int maxRes = 5000;
-									const float minAlpha = 15.f;
-									const float maxAlpha = 100.0f;
-
-									float t = std::clamp((float)(m_pointLightResolution - minRes) / (maxRes - minRes), 0.0f, 1.0f);
-									ray->color.a = (maxAlpha * (1.0f - t) + minAlpha * t);
-								}
+								const int minRes = 5;
+								const int maxRes = 5000;
+								const float minAlpha = 15.f;
+								const float maxAlpha = 100.0f;
+
+								float t = std::clamp((float)(m_pointLightResolution - minRes) / (maxRes - minRes), 0.0f, 1.0f);
+								emitter->color.a = (maxAlpha * (1.0f - t) + minAlpha * t);
 							}
 						}
 					}
@@ -123,15 +108,16 @@ void Simulation::sGui()
 				{
 					m_stateChange = true;
 					sf::Color color = wavelengthToRGB(m_wavelengthCreation);
-					for (auto& e : m_entities.getEntities())
+					for (auto& [marker, e] : m_entities.components<CMarker>())
 					{
-						if (e->getTag() == "Marker" && e->cMarker &&
-							e->cMarker->getRole() == MarkerRole::ColouredPointLightMarker)
+						if (e->getTag() == "Marker" &&
+							marker.getRole() == MarkerRole::ColouredPointLightMarker)
 						{
-							for (RayData* ray : e->cMarker->getRays())
+							if (Emitter* emitter = m_emitters.get(marker.getTargetEmitter()))
 							{
-								color.a = ray->color.a; // maintain alpha
-								ray->color = color;
+								color.a = emitter->color.a; // maintain alpha
+								emitter->color = color;
+								emitter->wavelength = m_wavelengthCreation;
 							}
 						}
 					}
@@ -155,6 +141,40 @@ void Simulation::sGui()
 				}
 				ImGui::EndMenu();
 			}
+			if (ImGui::BeginMenu("Emitter"))
+			{
+				// Emitters are expanded into rays on the GPU so they can have far more rays than a point light
+				static const char* emitterTypeNames[] = { "Point", "Collimated Beam", "Cone", "Area" };
+				int emitterType = static_cast<int>(m_emitterSettings.type);
+				if (ImGui::Combo("Type", &emitterType, emitterTypeNames, IM_ARRAYSIZE(emitterTypeNames)))
+				{
+					m_emitterSettings.type = static_cast<EmitterType>(emitterType);
+				}
+				int rayCount = static_cast<int>(m_emitterSettings.rayCount);
+				if (ImGui::SliderInt("Rays", &rayCount, 1, RayCollisionBuffers::maxBufferSize, "%d", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_AlwaysClamp))
+				{
+					m_emitterSettings.rayCount = static_cast<unsigned int>(rayCount);
+				}
+				if (m_emitterSettings.type == EmitterType::Collimated || m_emitterSettings.type == EmitterType::Area)
+				{
+					ImGui::SliderFloat("Width", &m_emitterSettings.width, 1.0f, 1000.0f, "%.1f");
+				}
+				if (m_emitterSettings.type == EmitterType::Cone || m_emitterSettings.type == EmitterType::Area)
+				{
+					float halfAngle = m_emitterSettings.halfAngle * 180.0f / pi;
+					if (ImGui::SliderFloat("Half Angle", &halfAngle, 0.0f, 90.0f, "%.1f"))
+					{
+						m_emitterSettings.halfAngle = halfAngle * pi / 180.0f;
+					}
+				}
+				ImGui::Checkbox("White Light", &m_emitterSettings.whiteLight);
+				if (ImGui::Button("Place Emitter"))
+				{
+					m_placingMarker = true;
+					m_placingEmitter = true;
+				}
+				ImGui::EndMenu();
+			}
 			ImGui::EndMenu();
 		}
 
@@ -188,6 +208,67 @@ void Simulation::sGui()
 			ImGui::EndMenu();
 		}
 
+		if (ImGui::BeginMenu("Detector"))
+		{
+			float windowWidth = ImGui::GetWindowWidth();
+			float buttonWidth = ImGui::CalcTextSize(" Create Detector ").x;
+			ImGui::SetCursorPosX((windowWidth - buttonWidth) * 0.5f);
+			if (ImGui::Button("Create Detector", ImVec2(buttonWidth, 0)))
+			{
+				m_placingMarker = true;
+				m_placingDetector = true;
+				m_showDetectorReadout = true;
+			}
+			ImGui::Checkbox("Show Readout", &m_showDetectorReadout);
+			ImGui::EndMenu();
+		}
+		if (m_showDetectorReadout)
+		{
+			ImGui::Begin("Detector Readout", &m_showDetectorReadout, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse);
+			if (m_detectorCount == 0)
+			{
+				ImGui::Text("No detectors, place one from the Detector menu.");
+			}
+			else if (m_buffers.currRayCount > 0)
+			{
+				ImGui::Text("Tracing...");
+			}
+			else
+			{
+				constexpr uint positionBins = RayCollisionBuffers::detectorPositionBins;
+				constexpr uint wavelengthBins = RayCollisionBuffers::detectorWavelengthBins;
+				for (uint d = 0; d < m_detectorCount; ++d)
+				{
+					// Collapse the histogram into how much energy landed at each position and how much of each wavelength arrived
+					std::vector<float> profile(positionBins, 0.0f);
+					std::vector<float> spectrum(wavelengthBins, 0.0f);
+					float total = 0.0f;
+					for (uint p = 0; p < positionBins; ++p)
+					{
+						for (uint w = 0; w < wavelengthBins; ++w)
+						{
+							float energy = (float)((double)m_buffers.detectorHistogram[(d * positionBins + p) * wavelengthBins + w] / RayCollisionBuffers::detectorEnergyScale);
+							profile[p] += energy;
+							spectrum[w] += energy;
+							total += energy;
+						}
+					}
+
+					std::string label = "Detector " + std::to_string(d + 1);
+					if (ImGui::TreeNodeEx(label.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+					{
+						ImGui::Text("Total energy: %.3f", total);
+						ImGui::PlotHistogram(("Position##" + label).c_str(), profile.data(), positionBins, 0, nullptr, 0.0f, FLT_MAX, ImVec2(300, 80));
+						char overlay[64];
+						snprintf(overlay, sizeof(overlay), "%.0f - %.0f nm", m_startWavelength, m_endWavelength);
+						ImGui::PlotHistogram(("Spectrum##" + label).c_str(), spectrum.data(), wavelengthBins, 0, overlay, 0.0f, FLT_MAX, ImVec2(300, 80));
+						ImGui::TreePop();
+					}
+				}
+			}
+			ImGui::End();
+		}
+
 		static bool polygonSettingsWindow = false;
 		static bool sellmeierProfileWindow = false;
 		static bool sellmeierReviewWindow = false;
@@ -461,6 +542,7 @@ void Simulation::sGui()
 						factorEnums[dstFactorIndex],
 						equationEnums[equationIndex]
 					);
+					m_rayLayerDirty = true;
 				}
 
 				ImGui::Text("Current: %s / %s / %s",
@@ -471,6 +553,149 @@ void Simulation::sGui()
 				ImGui::EndMenu();
 			}
 
+			if (ImGui::BeginMenu("Curve Accuracy"))
+			{
+				// Lenses and arcs are split into the fewest edges that stay this close to the true curve, fewer edges means a faster trace
+				ImGui::SliderFloat("Max Chord Error", &m_maxChordError, 0.001f, 5.0f, "%.3f", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_AlwaysClamp);
+				ImGui::Checkbox("Zoom Aware", &m_zoomAwareTessellation);
+				if (m_zoomAwareTessellation)
+				{
+					ImGui::SliderFloat("Max Error (pixels)", &m_maxChordErrorPixels, 0.05f, 2.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+				}
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Devices"))
+			{
+				// Other GPUs and the CPU runtime each trace a slice of every generation, sized by how fast they were last time
+				bool useAllDevices = m_traceScheduler.isEnabled();
+				if (ImGui::Checkbox("Use All Devices", &useAllDevices))
+				{
+					m_traceScheduler.setEnabled(useAllDevices);
+					m_stateChange = true;
+				}
+				ImGui::Text("%s: %.2f Mrays/s", m_device.info.name.c_str(), m_traceScheduler.getPrimaryRaysPerSecond() * 1e-6);
+				for (const auto& secondary : m_traceScheduler.getSecondaries())
+				{
+					ImGui::Text("%s: %.2f Mrays/s", secondary->device->info.name.c_str(), secondary->raysPerSecond * 1e-6);
+				}
+
+				ImGui::Separator();
+				// Branch-free kernels for mirror cavities, single-glass lens trains and so on, compiled in the background the first time each scene type is seen
+				if (ImGui::Checkbox("Specialise Kernels To Scene", &m_specialiseKernels))
+				{
+					m_stateChange = true;
+				}
+				ImGui::TextWrapped("Kernel variant:%s%s", m_kernelVariant.empty() ? " generic" : m_kernelVariant.c_str(),
+					m_device.is_variant_ready(m_kernelVariant) ? "" : "\n(compiling, using the generic kernel until it's ready)");
+				// Each work group loads the edges into local memory together, usually faster once there are a lot of edges
+				if (ImGui::Checkbox("Tile Edges In Local Memory", &m_tileEdges))
+				{
+					m_stateChange = true;
+				}
+				const std::string kernelName = m_tileEdges ? "ray_fresnel_mode_tiled" : "ray_fresnel_mode";
+				if (m_launchTuner.isTuned(m_device, kernelName))
+				{
+					LaunchConfig launch = m_launchTuner.getBest(m_device, kernelName);
+					ImGui::Text("Work group %u, %u rays per item, chunk %u", launch.workgroupSize, launch.raysPerItem, launch.chunkSize);
+				}
+				else
+				{
+					ImGui::Text("Launch parameters still being tuned");
+				}
+				if (ImGui::Button("Retune Launch Parameters"))
+				{
+					m_launchTuner.retune();
+				}
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Profiler"))
+			{
+				// Reorders every generation by a Morton code of its origin and its direction before tracing it
+				if (ImGui::Checkbox("Sort Rays For Coherence", &m_sortRays))
+				{
+					m_rayTree.clear(); // Trace everything again so the two can be compared
+					m_stateChange = true;
+				}
+				// Moving an entity only re-traces the rays that hit it or cross it, the rest of the last trace is kept
+				if (ImGui::Checkbox("Incremental Re-trace", &m_incrementalTracing))
+				{
+					m_rayTree.clear();
+					m_stateChange = true;
+				}
+				if (m_incrementalTracing)
+				{
+					ImGui::Text("Ray tree: %zu segments", m_rayTree.size());
+				}
+
+				ImGui::Text("Last trace: %llu rays, %.2f ms", static_cast<unsigned long long>(m_traceProfiler.getLastRayCount()), m_traceProfiler.getLastTotalMilliseconds());
+				for (int i = 0; i < static_cast<int>(TraceProfiler::Stage::Count); ++i)
+				{
+					TraceProfiler::Stage stage = static_cast<TraceProfiler::Stage>(i);
+					ImGui::Text("%s: %.2f ms", TraceProfiler::stageName(stage), m_traceProfiler.getLastMilliseconds(stage));
+				}
+				// The kernel time per ray is what sorting is meant to bring down, compare it with sorting on and off
+				double raysInMillions = m_traceProfiler.getLastRayCount() * 1e-6;
+				if (raysInMillions > 0.0)
+				{
+					ImGui::Text("Kernel: %.2f ms per million rays", m_traceProfiler.getLastMilliseconds(TraceProfiler::Stage::Kernel) / raysInMillions);
+				}
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("Spectral Sampling"))
+			{
+				// Each white ray splits into a few wavelengths rather than all of them, and passes are added until the spectrum fills in
+				bool changed = ImGui::Checkbox("Hero Wavelengths", &m_heroWavelengths);
+				changed |= ImGui::SliderInt("Wavelengths Per Split", &m_heroWavelengthCount, 1, 16);
+				changed |= ImGui::SliderInt("Passes", &m_spectralPasses, 1, 1024);
+				if (changed)
+				{
+					m_heroWavelengthCount = std::max(m_heroWavelengthCount, 1);
+					m_spectralPasses = std::max(m_spectralPasses, 1);
+					m_stateChange = true;
+				}
+				if (m_heroWavelengths)
+				{
+					ImGui::Text("Pass %d / %d", m_spectralPass + 1, m_spectralPasses);
+				}
+
+				ImGui::Separator();
+				// White light stays as one bundle until the ends of its band drift apart, hero wavelengths take over when both are on
+				changed = ImGui::Checkbox("Lazy Dispersion", &m_lazyDispersion);
+				changed |= ImGui::SliderFloat("Split Tolerance", &m_dispersionTolerance, 0.1f, 50.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+				if (changed)
+				{
+					m_dispersionTolerance = std::max(m_dispersionTolerance, 0.01f);
+					m_stateChange = true;
+				}
+				ImGui::EndMenu();
+			}
+
+			if (ImGui::BeginMenu("World Bounds"))
+			{
+				// Rays that miss everything stop here, a big box just means longer lines, the view clips them when they're drawn
+				float position[2] = { m_worldBounds.position.x, m_worldBounds.position.y };
+				float size[2] = { m_worldBounds.size.x, m_worldBounds.size.y };
+				bool changed = ImGui::InputFloat2("Top Left", position);
+				changed |= ImGui::InputFloat2("Size", size);
+				if (ImGui::Button("Fit To View"))
+				{
+					position[0] = m_view.getCenter().x - m_view.getSize().x / 2.0f;
+					position[1] = m_view.getCenter().y - m_view.getSize().y / 2.0f;
+					size[0] = m_view.getSize().x;
+					size[1] = m_view.getSize().y;
+					changed = true;
+				}
+				if (changed && size[0] > 0.0f && size[1] > 0.0f)
+				{
+					m_worldBounds = sf::FloatRect({ position[0], position[1] }, { size[0], size[1] });
+					m_stateChange = true;
+				}
+				ImGui::EndMenu();
+			}
+
 			ImGui::MenuItem("Settings");
 			if (ImGui::BeginMenu("Screenshot"))
 			{
@@ -479,6 +704,16 @@ void Simulation::sGui()
 					std::string filename = "Screenshots/screenshot_" + std::to_string(time(nullptr)) + ".png";
 					saveScreenshot(filename);
 				}
+
+				// Offline export of the demo prism / wavelength animations, one PNG per frame
+				static int exportFrameCount = 600;
+				ImGui::InputInt("Frames", &exportFrameCount);
+				exportFrameCount = std::max(exportFrameCount, 1);
+				if (ImGui::Button("Export Animation"))
+				{
+					std::string directory = "Screenshots/animation_" + std::to_string(time(nullptr));
+					exportFrameSequence(directory, exportFrameCount);
+				}
 				ImGui::EndMenu();
 			}
 
@@ -565,7 +800,7 @@ void Simulation::sGui()
 
 				if (m_selectedEntity->cCustomShape)
 				{
-					auto lensShape = dynamic_cast<MyLensShape*>(m_selectedEntity->cCustomShape->customShape.get());
+					auto lensShape = m_selectedEntity->cCustomShape->as<MyLensShape>();
 					if (lensShape)
 					{
 						sf::Vector2f pos = lensShape->getPosition();
@@ -576,7 +811,7 @@ void Simulation::sGui()
 							updateRotatorPosition();
 						}
 					}
-					else if (auto prismShape = dynamic_cast<PrismDemoShape*>(m_selectedEntity->cCustomShape->customShape.get()))
+					else if (auto prismShape = m_selectedEntity->cCustomShape->as<PrismDemoShape>())
 					{
 						float alpha = prismShape->getAlpha() * 180.0f / pi;
 						float incidentAngle = prismShape->getIncidentAngle() * 180.0f / pi;
@@ -598,7 +833,7 @@ void Simulation::sGui()
 							prismShape->setAlphaIncrement(alphaIncrement * pi / 180.0f);
 						}
 					}
-					else if (auto customPrismShape = dynamic_cast<CustomPolygonPrism*>(m_selectedEntity->cCustomShape->customShape.get()))
+					else if (auto customPrismShape = m_selectedEntity->cCustomShape->as<CustomPolygonPrism>())
 					{
 						sf::Vector2f pos = customPrismShape->getPosition();
 						if (ImGui::InputFloat("Position X", &pos.x) || ImGui::InputFloat("Position Y", &pos.y))
@@ -654,25 +889,22 @@ void Simulation::sGui()
 					}
 				}
 
+				// Anything edited above may have moved or resized the entity
+				if (m_stateChange)
+					sRefreshPickBounds(m_selectedEntity);
+
 				if (ImGui::Button("Delete Entity"))
 				{
-					if (auto shape = dynamic_cast<PrismDemoShape*>(m_selectedEntity->cCustomShape ? m_selectedEntity->cCustomShape->customShape.get() : nullptr))
+					if (auto shape = (m_selectedEntity->cCustomShape ? m_selectedEntity->cCustomShape->as<PrismDemoShape>() : nullptr))
 					{
-						if (RayData* incidentRay = shape->getIncidentRay())
-						{
-							auto it = std::remove_if(m_lightSources.begin(), m_lightSources.end(),
-								[incidentRay](const std::unique_ptr<RayData>& ray) {
-									return ray.get() == incidentRay;
-								});
-							m_lightSources.erase(it, m_lightSources.end());
-						}
+						sRemoveRay(shape->getIncidentRay());
 					}
 
-					if (auto lensShape = dynamic_cast<MyLensShape*>(m_selectedEntity->cCustomShape ? m_selectedEntity->cCustomShape->customShape.get() : nullptr))
+					if (auto lensShape = (m_selectedEntity->cCustomShape ? m_selectedEntity->cCustomShape->as<MyLensShape>() : nullptr))
 					{
 						lensShape->destroyMarkers();
 					}
-					if(auto customPrismShape = dynamic_cast<CustomPolygonPrism*>(m_selectedEntity->cCustomShape ? m_selectedEntity->cCustomShape->customShape.get() : nullptr))
+					if(auto customPrismShape = (m_selectedEntity->cCustomShape ? m_selectedEntity->cCustomShape->as<CustomPolygonPrism>() : nullptr))
 					{
 						customPrismShape->destroyMarkers();
 					}
@@ -696,6 +928,7 @@ void Simulation::sGui()
 			m_placingMarker = false;
 			m_placingSingleRay = false;
 			m_placingCustomPrism = false;
+			m_placingEmitter = false;
 
 			// Optionally clear preview from previous prism marker
 			if (m_previousMarker && m_previousMarker->cMarker)
@@ -704,7 +937,7 @@ void Simulation::sGui()
 				{
 					if (auto* customShape = customPrism->cCustomShape.get())
 					{
-						if (auto* prismShape = dynamic_cast<CustomPolygonPrism*>(customShape->customShape.get()))
+						if (auto* prismShape = customShape->as<CustomPolygonPrism>())
 						{
 							prismShape->clearPreview();
 						}
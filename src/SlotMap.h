@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Refers to an element of a SlotMap. Stays valid until that element is removed, after which it never refers to anything again
+// even when the slot gets reused, so holding one is safe where holding a pointer wouldn't be.
+struct SlotHandle
+{
+	std::uint32_t index = UINT32_MAX;
+	std::uint32_t generation = 0;
+
+	bool operator==(const SlotHandle& other) const = default;
+	bool isNull() const { return index == UINT32_MAX; }
+};
+
+// Dense storage with stable handles. Elements are packed into one contiguous array so they can be iterated or bulk copied,
+// removal swaps the last element into the gap so is O(1). Pointers returned by get() move around on insert and remove, keep the handle instead.
+template<typename T>
+class SlotMap
+{
+	struct Slot
+	{
+		std::uint32_t denseIndex = 0;
+		std::uint32_t generation = 1; // Starts at 1 so a default SlotHandle never matches
+	};
+
+	std::vector<T> m_dense;
+	std::vector<std::uint32_t> m_denseToSlot; // Which slot owns each dense element, needed to fix up the slot of the element moved by remove()
+	std::vector<Slot> m_slots;
+	std::vector<std::uint32_t> m_freeSlots;
+
+	std::uint32_t claimSlot()
+	{
+		std::uint32_t slotIndex;
+		if (!m_freeSlots.empty())
+		{
+			slotIndex = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slotIndex = static_cast<std::uint32_t>(m_slots.size());
+			m_slots.emplace_back();
+		}
+		m_slots[slotIndex].denseIndex = static_cast<std::uint32_t>(m_dense.size());
+		m_denseToSlot.push_back(slotIndex);
+		return slotIndex;
+	}
+
+public:
+	SlotHandle insert(const T& value)
+	{
+		const std::uint32_t slotIndex = claimSlot();
+		m_dense.push_back(value);
+		return SlotHandle{ slotIndex, m_slots[slotIndex].generation };
+	}
+
+	// For elements that can't be copied
+	SlotHandle insert(T&& value)
+	{
+		const std::uint32_t slotIndex = claimSlot();
+		m_dense.push_back(std::move(value));
+		return SlotHandle{ slotIndex, m_slots[slotIndex].generation };
+	}
+
+	// Does nothing if the handle is stale or null
+	void remove(SlotHandle handle)
+	{
+		if (!contains(handle)) return;
+
+		Slot& slot = m_slots[handle.index];
+		const std::uint32_t hole = slot.denseIndex;
+		const std::uint32_t last = static_cast<std::uint32_t>(m_dense.size() - 1);
+		if (hole != last)
+		{
+			m_dense[hole] = std::move(m_dense[last]);
+			m_denseToSlot[hole] = m_denseToSlot[last];
+			m_slots[m_denseToSlot[hole]].denseIndex = hole;
+		}
+		m_dense.pop_back();
+		m_denseToSlot.pop_back();
+
+		// Bumping the generation is what makes every existing handle to this slot stale
+		slot.generation++;
+		m_freeSlots.push_back(handle.index);
+	}
+
+	bool contains(SlotHandle handle) const
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+	}
+
+	T* get(SlotHandle handle)
+	{
+		return contains(handle) ? &m_dense[m_slots[handle.index].denseIndex] : nullptr;
+	}
+
+	const T* get(SlotHandle handle) const
+	{
+		return contains(handle) ? &m_dense[m_slots[handle.index].denseIndex] : nullptr;
+	}
+
+	void clear()
+	{
+		for (std::uint32_t slotIndex : m_denseToSlot)
+		{
+			m_slots[slotIndex].generation++;
+			m_freeSlots.push_back(slotIndex);
+		}
+		m_dense.clear();
+		m_denseToSlot.clear();
+	}
+
+	// Handle of the element at a dense index, e.g. while walking data()
+	SlotHandle handleAt(std::size_t denseIndex) const
+	{
+		const std::uint32_t slotIndex = m_denseToSlot[denseIndex];
+		return SlotHandle{ slotIndex, m_slots[slotIndex].generation };
+	}
+
+	std::size_t size() const { return m_dense.size(); }
+	bool empty() const { return m_dense.empty(); }
+	T* data() { return m_dense.data(); }
+	const T* data() const { return m_dense.data(); }
+
+	typename std::vector<T>::iterator begin() { return m_dense.begin(); }
+	typename std::vector<T>::iterator end() { return m_dense.end(); }
+	typename std::vector<T>::const_iterator begin() const { return m_dense.begin(); }
+	typename std::vector<T>::const_iterator end() const { return m_dense.end(); }
+};
@@ -0,0 +1,115 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float cellSize)
+	: m_cellSize(cellSize)
+{
+}
+
+int SpatialGrid::cellCoord(float value) const
+{
+	return static_cast<int>(std::floor(value / m_cellSize));
+}
+
+std::uint64_t SpatialGrid::cellKey(int x, int y)
+{
+	return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
+
+SpatialGrid::CellRange SpatialGrid::cellRange(const sf::FloatRect& bounds) const
+{
+	CellRange range;
+	range.minX = cellCoord(bounds.position.x);
+	range.minY = cellCoord(bounds.position.y);
+	range.maxX = cellCoord(bounds.position.x + bounds.size.x);
+	range.maxY = cellCoord(bounds.position.y + bounds.size.y);
+	long long cellCount = static_cast<long long>(range.maxX - range.minX + 1) * (range.maxY - range.minY + 1);
+	range.oversized = cellCount > maxCellsPerEntity;
+	return range;
+}
+
+void SpatialGrid::eraseFrom(std::vector<Entity*>& list, Entity* entity)
+{
+	auto it = std::find(list.begin(), list.end(), entity);
+	if (it != list.end())
+	{
+		*it = list.back();
+		list.pop_back();
+	}
+}
+
+void SpatialGrid::unlink(Entity* entity, const CellRange& range)
+{
+	if (range.oversized)
+	{
+		eraseFrom(m_oversized, entity);
+		return;
+	}
+	for (int x = range.minX; x <= range.maxX; ++x)
+	{
+		for (int y = range.minY; y <= range.maxY; ++y)
+		{
+			auto cell = m_cells.find(cellKey(x, y));
+			if (cell == m_cells.end()) continue;
+			eraseFrom(cell->second, entity);
+			if (cell->second.empty()) m_cells.erase(cell);
+		}
+	}
+}
+
+void SpatialGrid::update(Entity* entity, const sf::FloatRect& bounds)
+{
+	CellRange range = cellRange(bounds);
+
+	auto existing = m_ranges.find(entity);
+	if (existing != m_ranges.end())
+	{
+		// Most moves stay within the same cells so there's nothing to do
+		if (existing->second == range) return;
+		unlink(entity, existing->second);
+		existing->second = range;
+	}
+	else
+	{
+		m_ranges.emplace(entity, range);
+	}
+
+	if (range.oversized)
+	{
+		m_oversized.push_back(entity);
+		return;
+	}
+	for (int x = range.minX; x <= range.maxX; ++x)
+	{
+		for (int y = range.minY; y <= range.maxY; ++y)
+		{
+			m_cells[cellKey(x, y)].push_back(entity);
+		}
+	}
+}
+
+void SpatialGrid::remove(Entity* entity)
+{
+	auto existing = m_ranges.find(entity);
+	if (existing == m_ranges.end()) return;
+	unlink(entity, existing->second);
+	m_ranges.erase(existing);
+}
+
+void SpatialGrid::clear()
+{
+	m_cells.clear();
+	m_ranges.clear();
+	m_oversized.clear();
+}
+
+void SpatialGrid::query(const sf::Vector2f& point, std::vector<Entity*>& out) const
+{
+	auto cell = m_cells.find(cellKey(cellCoord(point.x), cellCoord(point.y)));
+	if (cell != m_cells.end())
+	{
+		out.insert(out.end(), cell->second.begin(), cell->second.end());
+	}
+	out.insert(out.end(), m_oversized.begin(), m_oversized.end());
+}
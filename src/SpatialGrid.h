@@ -0,0 +1,46 @@
+#pragma once
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System/Vector2.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Entity;
+
+// Uniform grid over entity bounds, used for mouse picking so a click only tests the few entities near it.
+// Each entity sits in every cell its bounds overlap and is only moved between cells when those cells change.
+// Anything spanning more than maxCellsPerEntity cells goes in one list every query checks instead, there are only ever a few of those.
+class SpatialGrid
+{
+	struct CellRange
+	{
+		int minX = 0, minY = 0, maxX = 0, maxY = 0;
+		bool oversized = false;
+
+		bool operator==(const CellRange& other) const = default;
+	};
+
+	float m_cellSize;
+	std::unordered_map<std::uint64_t, std::vector<Entity*>> m_cells;
+	std::unordered_map<Entity*, CellRange> m_ranges;
+	std::vector<Entity*> m_oversized;
+
+	static constexpr int maxCellsPerEntity = 256;
+
+	CellRange cellRange(const sf::FloatRect& bounds) const;
+	int cellCoord(float value) const;
+	static std::uint64_t cellKey(int x, int y);
+	static void eraseFrom(std::vector<Entity*>& list, Entity* entity);
+	void unlink(Entity* entity, const CellRange& range);
+
+public:
+	explicit SpatialGrid(float cellSize = 64.0f);
+
+	// Inserts the entity or moves it if it's already in the grid
+	void update(Entity* entity, const sf::FloatRect& bounds);
+	void remove(Entity* entity);
+	void clear();
+
+	// Appends every entity whose bounds might contain the point, in no particular order
+	void query(const sf::Vector2f& point, std::vector<Entity*>& out) const;
+};
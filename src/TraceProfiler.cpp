@@ -0,0 +1,56 @@
+#include "TraceProfiler.h"
+
+void TraceProfiler::begin()
+{
+	m_current.fill(0.0);
+	m_currentRays = 0;
+}
+
+void TraceProfiler::add(Stage stage, double seconds)
+{
+	m_current[static_cast<size_t>(stage)] += seconds;
+}
+
+void TraceProfiler::addRays(std::uint64_t count)
+{
+	m_currentRays += count;
+}
+
+void TraceProfiler::finish()
+{
+	m_last = m_current;
+	m_lastRays = m_currentRays;
+	begin();
+}
+
+const char* TraceProfiler::stageName(Stage stage)
+{
+	switch (stage)
+	{
+	case Stage::Setup: return "Setup";
+	case Stage::Sort: return "Sort";
+	case Stage::Kernel: return "Kernel";
+	case Stage::PostProcess: return "Post-process";
+	default: return "";
+	}
+}
+
+double TraceProfiler::getLastMilliseconds(Stage stage) const
+{
+	return m_last[static_cast<size_t>(stage)] * 1000.0;
+}
+
+double TraceProfiler::getLastTotalMilliseconds() const
+{
+	double total = 0.0;
+	for (double seconds : m_last)
+	{
+		total += seconds;
+	}
+	return total * 1000.0;
+}
+
+std::uint64_t TraceProfiler::getLastRayCount() const
+{
+	return m_lastRays;
+}
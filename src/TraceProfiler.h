@@ -0,0 +1,37 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Adds up where the time goes over one whole trace (from a state change until every ray has finished, often several frames)
+// and keeps the totals of the last finished trace for the Profiler menu.
+class TraceProfiler
+{
+public:
+	enum class Stage
+	{
+		Setup,       // Building and uploading the edges and materials
+		Sort,        // Reordering each generation for coherence
+		Kernel,      // Intersection on every device, including transfers
+		PostProcess, // Spawning the next generation on the host
+		Count
+	};
+
+	// Starts counting a new trace, whatever the last one had so far is thrown away
+	void begin();
+	void add(Stage stage, double seconds);
+	void addRays(std::uint64_t count);
+	// The trace has converged, keep its totals
+	void finish();
+
+	static const char* stageName(Stage stage);
+	double getLastMilliseconds(Stage stage) const;
+	double getLastTotalMilliseconds() const;
+	std::uint64_t getLastRayCount() const;
+
+private:
+	std::array<double, static_cast<size_t>(Stage::Count)> m_current{};
+	std::array<double, static_cast<size_t>(Stage::Count)> m_last{};
+	std::uint64_t m_currentRays = 0;
+	std::uint64_t m_lastRays = 0;
+};
@@ -0,0 +1,169 @@
+#include "TraceScheduler.h"
+#include <algorithm>
+#include <iostream>
+
+TraceScheduler::TraceScheduler(Device& primary)
+	: m_primary(primary)
+{
+}
+
+bool TraceScheduler::isEnabled() const
+{
+	return m_enabled && !m_secondaries.empty();
+}
+
+void TraceScheduler::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if (m_enabled && !m_devicesCreated)
+	{
+		createDevices();
+	}
+}
+
+void TraceScheduler::createDevices()
+{
+	m_devicesCreated = true;
+	std::vector<std::string> cpuNames;
+	if (m_primary.info.is_cpu) cpuNames.push_back(m_primary.info.name);
+
+	for (const Device_Info& info : get_devices(false))
+	{
+		if (info.cl_device() == m_primary.info.cl_device()) continue;
+		if (info.is_cpu)
+		{
+			// The same CPU often shows up once per installed runtime, running on it twice would just fight over the cores
+			if (std::find(cpuNames.begin(), cpuNames.end(), info.name) != cpuNames.end()) continue;
+			cpuNames.push_back(info.name);
+
+			cl::Device cpu = info.cl_device;
+			std::vector<cl::Device> nodes;
+			const cl_device_partition_property numaSplit[] = {
+				CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0
+			};
+			if (cpu.createSubDevices(numaSplit, &nodes) == CL_SUCCESS && nodes.size() > 1)
+			{
+				for (const cl::Device& node : nodes)
+				{
+					addDevice(Device_Info(node, cl::Context(node), info.id));
+				}
+				continue;
+			}
+		}
+		addDevice(info);
+	}
+
+	if (m_secondaries.empty())
+	{
+		std::cerr << "No other OpenCL devices found, tracing stays on " << m_primary.info.name << std::endl;
+	}
+}
+
+void TraceScheduler::addDevice(const Device_Info& info)
+{
+	auto secondary = std::make_unique<SecondaryDevice>();
+	secondary->device = std::make_unique<Device>(info);
+	secondary->buffers = std::make_unique<RayCollisionBuffers>(*secondary->device);
+	m_secondaries.push_back(std::move(secondary));
+}
+
+std::vector<TraceScheduler::Slice> TraceScheduler::partition(uint rayCount) const
+{
+	std::vector<Slice> slices;
+	slices.push_back(Slice{ nullptr, 0, rayCount });
+	if (!isEnabled() || rayCount < 2 * minSliceSize) return slices;
+
+	// Until every device has been timed the only thing to go on is their estimated FLOPs
+	bool allTimed = m_primaryRaysPerSecond > 0.0;
+	for (const auto& secondary : m_secondaries)
+	{
+		allTimed = allTimed && secondary->raysPerSecond > 0.0;
+	}
+	auto weightOf = [allTimed](double raysPerSecond, const Device& device) {
+		return allTimed ? raysPerSecond : std::max(static_cast<double>(device.info.tflops), 0.001);
+		};
+
+	double totalWeight = weightOf(m_primaryRaysPerSecond, m_primary);
+	for (const auto& secondary : m_secondaries)
+	{
+		totalWeight += weightOf(secondary->raysPerSecond, *secondary->device);
+	}
+
+	uint offset = rayCount;
+	for (const auto& secondary : m_secondaries)
+	{
+		double share = weightOf(secondary->raysPerSecond, *secondary->device) / totalWeight;
+		uint count = static_cast<uint>(share * rayCount);
+		if (count < minSliceSize) continue; // Stays with the main device
+		offset -= count;
+		slices.push_back(Slice{ secondary.get(), offset, count });
+	}
+	// The main device takes whatever is left at the front
+	slices[0].count = offset;
+	return slices;
+}
+
+void TraceScheduler::recordTiming(SecondaryDevice* secondary, uint rayCount, double seconds)
+{
+	if (seconds <= 0.0 || rayCount == 0) return;
+	double measured = rayCount / seconds;
+	double& raysPerSecond = secondary ? secondary->raysPerSecond : m_primaryRaysPerSecond;
+	raysPerSecond = raysPerSecond > 0.0 ? raysPerSecond + timingSmoothing * (measured - raysPerSecond) : measured;
+}
+
+void TraceScheduler::uploadScene(const RayCollisionBuffers& source, uint edgeCount, uint entityCount, uint materialCount, std::uint64_t materials)
+{
+	if (!isEnabled()) return;
+	for (const auto& secondary : m_secondaries)
+	{
+		secondary->buffers->copySceneFrom(source, edgeCount, entityCount);
+		if (secondary->materials != materials)
+		{
+			secondary->buffers->copyMaterialsFrom(source, materialCount);
+			secondary->materials = materials;
+		}
+	}
+}
+
+void TraceScheduler::prepareVariant(const std::string& defines)
+{
+	m_primary.prepare_variant(defines);
+	if (!isEnabled()) return;
+	for (const auto& secondary : m_secondaries)
+	{
+		secondary->device->prepare_variant(defines);
+	}
+}
+
+void TraceScheduler::gatherDetectors(RayCollisionBuffers& target, uint detectorCount)
+{
+	if (!isEnabled() || detectorCount == 0) return;
+	const uint binCount = detectorCount * RayCollisionBuffers::detectorPositionBins * RayCollisionBuffers::detectorWavelengthBins;
+	for (const auto& secondary : m_secondaries)
+	{
+		Memory<ulong>& histogram = secondary->buffers->detectorHistogram;
+		histogram.read_from_device(0, binCount);
+		for (uint i = 0; i < binCount; ++i)
+		{
+			target.detectorHistogram[i] += histogram[i];
+		}
+	}
+}
+
+void TraceScheduler::resetDetectors()
+{
+	for (const auto& secondary : m_secondaries)
+	{
+		secondary->buffers->detectorHistogram.reset();
+	}
+}
+
+const std::vector<std::unique_ptr<TraceScheduler::SecondaryDevice>>& TraceScheduler::getSecondaries() const
+{
+	return m_secondaries;
+}
+
+double TraceScheduler::getPrimaryRaysPerSecond() const
+{
+	return m_primaryRaysPerSecond;
+}
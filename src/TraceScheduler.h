@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "RayCollisionBuffers.h"
+#include "opencl.hpp"
+
+// Splits each ray generation between the main device and every other OpenCL device in the machine (other GPUs, the CPU runtime).
+// Each device gets a slice of the rays sized by how many rays per second it managed last time, so a slow device doesn't hold the fast one up.
+// CPUs with more than one NUMA node are split into a sub-device per node so each node works on memory it owns.
+class TraceScheduler
+{
+public:
+	struct SecondaryDevice
+	{
+		std::unique_ptr<Device> device;             // Memory keeps a pointer to its Device so these can't move around
+		std::unique_ptr<RayCollisionBuffers> buffers; // This device's slice of the rays always starts at index 0
+		double raysPerSecond = 0.0;                 // Smoothed, 0 until the device has run once
+		std::uint64_t materials = 0;                // Which materials its buffers hold, see uploadScene
+	};
+
+	// A contiguous run of rays in the main buffers, secondary is nullptr for the main device's slice which always comes first
+	struct Slice
+	{
+		SecondaryDevice* secondary = nullptr;
+		uint offset = 0;
+		uint count = 0;
+	};
+
+	explicit TraceScheduler(Device& primary);
+
+	bool isEnabled() const;
+	// The other devices are only created (and their kernels compiled) the first time this is turned on
+	void setEnabled(bool enabled);
+
+	// Slices covering rays [0, rayCount), just the main device's if splitting is off or there aren't enough rays to be worth it
+	std::vector<Slice> partition(uint rayCount) const;
+	void recordTiming(SecondaryDevice* secondary, uint rayCount, double seconds);
+
+	// Mirrors the scene the main buffers hold onto every other device.
+	// materials identifies the main buffers' materials, they're only sent to a device that doesn't have them yet
+	void uploadScene(const RayCollisionBuffers& source, uint edgeCount, uint entityCount, uint materialCount, std::uint64_t materials);
+	// Starts compiling the kernel variant for defines on every device that doesn't have it yet, see Device::prepare_variant
+	void prepareVariant(const std::string& defines);
+	// Adds every other device's detector counts into target's host histogram, must be called right after target's histogram
+	// has been read back and with no slice still tracing
+	void gatherDetectors(RayCollisionBuffers& target, uint detectorCount);
+	void resetDetectors();
+
+	const std::vector<std::unique_ptr<SecondaryDevice>>& getSecondaries() const;
+	double getPrimaryRaysPerSecond() const;
+
+private:
+	Device& m_primary;
+	double m_primaryRaysPerSecond = 0.0;
+	std::vector<std::unique_ptr<SecondaryDevice>> m_secondaries;
+	bool m_enabled = false;
+	bool m_devicesCreated = false;
+
+	// Below this many rays launching on another device costs more than it saves, they stay on the main device
+	static constexpr uint minSliceSize = 4096;
+	// How much of each new timing goes into the smoothed rays per second
+	static constexpr double timingSmoothing = 0.2;
+
+	void createDevices();
+	void addDevice(const Device_Info& info);
+};
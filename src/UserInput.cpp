@@ -48,9 +48,14 @@ void Simulation::sUserInput()
 		handleMouseMoved(event);
 	}
 
-	handleDragging(mouseWorldPos);
+	// Holding a drag without moving the mouse changes nothing, so don't restart the trace for it
+	bool mouseMoved = mouseWorldPos != m_lastMouseWorldPos;
+	m_lastMouseWorldPos = mouseWorldPos;
 
-	if (m_isRotating && m_selectedEntity && m_rotator)
+	if (mouseMoved)
+		handleDragging(mouseWorldPos);
+
+	if (m_isRotating && m_selectedEntity && m_rotator && mouseMoved)
 	{
 		m_stateChange = true; 
 		auto& shape = m_selectedEntity->cShape->circle;
@@ -63,7 +68,7 @@ void Simulation::sUserInput()
 		if (m_previousMarker->cMarker && m_previousMarker->cMarker->getRole() == MarkerRole::polygonPrismMarker)
 		{
 			Entity* customPrism = m_previousMarker->cMarker->getTargetEntity();
-			CustomPolygonPrism* customPrismShape = dynamic_cast<CustomPolygonPrism*>(customPrism->cCustomShape->customShape.get());
+			CustomPolygonPrism* customPrismShape = customPrism->cCustomShape->as<CustomPolygonPrism>();
 			if (customPrismShape)
 			{
 				customPrismShape->setPreviewPoint(mouseWorldPos); 
@@ -73,8 +78,8 @@ void Simulation::sUserInput()
 
 	if (m_placingCircularArc && m_circularArcInProgress)
 	{
-		auto arcShape = dynamic_cast<CircularArcShape*>(m_circularArcInProgress->cCustomShape->customShape.get());
-		if (arcShape->getMarker(2))
+		auto arcShape = m_circularArcInProgress->cCustomShape->as<CircularArcShape>();
+		if (arcShape->getMarker(2) && mouseMoved)
 		{
 			m_stateChange = true;
 			arcShape->setMarkerPos(2,mouseWorldPos);
@@ -128,102 +133,116 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 		{
 			m_benchmarkClock.restart(); // Reset the benchmark clock
 			bool hitEntity = false;
-			for (auto& e : m_entities.getEntities())
+			// ---- Find what was clicked ----
+			// Only the entities near the mouse are tested. Circle shapes are handles (markers, prisms, the rotator)
+			// so they win over the custom shapes they sit on, otherwise the topmost entity wins
+			const std::vector<Entity*>& candidates = m_entities.queryPoint(mouseWorldPos);
+			Entity* hit = nullptr;
+			for (Entity* e : candidates)
 			{
-				if (e->cShape)
+				if (!e->cShape) continue;
+				auto& shape = e->cShape->circle;
+				float radius = shape.getRadius();
+				if (e->getTag() == "Marker")
 				{
-					auto& shape = e->cShape->circle;
-					float distance = magnitude(shape.getPosition() - mouseWorldPos);
-					float radius = shape.getRadius();
-					if (e->getTag() == "Marker")
+					radius = radius * 3; // Make the hitbox a bit bigger as markers are small
+				}
+				if (magnitude(shape.getPosition() - mouseWorldPos) <= radius)
+				{
+					hit = e;
+					break;
+				}
+			}
+			if (!hit)
+			{
+				for (Entity* e : candidates)
+				{
+					if (!e->cCustomShape) continue;
+					// if it is a custom polygon prism AND it isn't complete dont allow dragging
+					CustomPolygonPrism* customPrismShape = e->cCustomShape->as<CustomPolygonPrism>();
+					if (customPrismShape && !customPrismShape->getShapeComplete())
 					{
-						radius = radius * 3; // Make the hitbox a bit bigger as markers are small
+						continue;
 					}
-					if (distance <= radius)
+					if (shapeContainsPoint(*e->cCustomShape->customShape, mouseWorldPos))
 					{
-						hitEntity = true;
+						hit = e;
+						break;
+					}
+				}
+			}
 
-						if (e->getTag() == "Prism")
+			if (hit)
+			{
+				Entity* e = hit;
+				hitEntity = true;
+				if (e->cShape)
+				{
+					auto& shape = e->cShape->circle;
+					if (e->getTag() == "Prism")
+					{
+						m_selectedEntity = e;
+						m_isDragging = true;
+						m_dragOffset = e->cShape->circle.getPosition() - mouseWorldPos;
+						// Destroy old rotator
+						if (m_rotator != nullptr)
 						{
-							m_selectedEntity = e.get();
-							m_isDragging = true;
-							m_dragOffset = e->cShape->circle.getPosition() - mouseWorldPos;
-							// Destroy old rotator
-							if (m_rotator != nullptr)
-							{
-								m_rotator->m_dead = true;
-								m_rotator = nullptr;
-							}
-
-							// Create rotator about the currently selected entity
-							m_rotator = &m_entities.addEntity("Rotator");
-
-							// Create the small triangle arrow shape
-							m_rotator->cShape = std::make_unique<CShape>(
-								shape.getRadius() / 10.0f,   // smaller radius
-								3,                          // triangle
-								sf::Color(0, 0, 0, 0),     // transparent fill
-								sf::Color(255, 255, 255, 255), // white border
-								1.0f
-							);
+							m_rotator->m_dead = true;
+							m_rotator = nullptr;
+						}
 
-							sf::Vector2f point0 = shape.getPoint(0);
-							sf::Transform shapeTransform = shape.getTransform();
-							point0 = shapeTransform.transformPoint(point0);
+						// Create rotator about the currently selected entity
+						m_rotator = &m_entities.addEntity("Rotator");
 
-							m_rotator->cShape->circle.setRotation(shape.getRotation());
-							m_rotator->cShape->circle.setPosition(point0 + normalize(point0 - shape.getPosition()) * 25);
+						// Create the small triangle arrow shape
+						m_rotator->cShape = std::make_unique<CShape>(
+							shape.getRadius() / 10.0f,   // smaller radius
+							3,                          // triangle
+							sf::Color(0, 0, 0, 0),     // transparent fill
+							sf::Color(255, 255, 255, 255), // white border
+							1.0f
+						);
+						// Adding the rotator's shape can move every other CShape in memory, so shape can't be used past here
+						updateRotatorPosition();
 
 
-						}
-						else if (e->getTag() == "Rotator")
+					}
+					else if (e->getTag() == "Rotator")
+					{
+						if (m_selectedEntity && m_rotator)
 						{
-							if (m_selectedEntity && m_rotator)
-							{
-								// Rotate the rotator to face the mouse position
-								sf::Vector2f shapeToMouse = mouseWorldPos - m_rotator->cShape->circle.getPosition();
-								sf::Angle angle = sf::radians(std::atan2(shapeToMouse.y, shapeToMouse.x));
-								m_selectedEntity->cShape->circle.setRotation(angle);
-								m_isRotating = true;
+							// Rotate the rotator to face the mouse position
+							sf::Vector2f shapeToMouse = mouseWorldPos - m_rotator->cShape->circle.getPosition();
+							sf::Angle angle = sf::radians(std::atan2(shapeToMouse.y, shapeToMouse.x));
+							m_selectedEntity->cShape->circle.setRotation(angle);
+							m_isRotating = true;
 
-							}
-						}
-						else if (e->getTag() == "Marker")
-						{
-							// We don't want a rotator for markers
-							if (m_rotator != nullptr)
-							{
-								m_rotator->m_dead = true;
-								m_rotator = nullptr;
-							}
-							m_isDragging = true;
-							m_selectedEntity = e.get();
-							m_dragOffset = e->cShape->circle.getPosition() - mouseWorldPos;
 						}
-
-						break; // Only handle one entity per click
-					}
-				}
-				else // Custom shape
-				{
-					// if it is a custom polygon prism AND it isn't complete dont allow dragging
-					if (dynamic_cast<CustomPolygonPrism*>(e->cCustomShape->customShape.get()) && !dynamic_cast<CustomPolygonPrism*>(e->cCustomShape->customShape.get())->getShapeComplete())
-					{
-						continue;
 					}
-					if (shapeContainsPoint(*e->cCustomShape->customShape, mouseWorldPos))
+					else if (e->getTag() == "Marker")
 					{
-						m_dragOffset = e->cCustomShape->customShape->getPosition() - mouseWorldPos;
-						hitEntity = true;
+						// We don't want a rotator for markers
 						if (m_rotator != nullptr)
 						{
-							// Destroy old rotator
 							m_rotator->m_dead = true;
 							m_rotator = nullptr;
 						}
 						m_isDragging = true;
-						m_selectedEntity = e.get();
+						m_selectedEntity = e;
+						m_dragOffset = e->cShape->circle.getPosition() - mouseWorldPos;
+					}
+				}
+				else // Custom shape
+				{
+					m_dragOffset = e->cCustomShape->customShape->getPosition() - mouseWorldPos;
+					if (m_rotator != nullptr)
+					{
+						// Destroy old rotator
+						m_rotator->m_dead = true;
+						m_rotator = nullptr;
 					}
+					m_isDragging = true;
+					m_selectedEntity = e;
 				}
 			}
 			if (!hitEntity)
@@ -249,7 +268,7 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 							sf::Color(255, 0, 0, 122),
 							sf::Color(255, 255, 255, 255),
 							45.0f);
-						marker1->cMarker = std::make_unique<CMarker>(RayTag(), MarkerRole::singleRayMarker1, nullptr);
+						marker1->cMarker = std::make_unique<CMarker>(RayTag(), MarkerRole::singleRayMarker1, SlotHandle());
 
 						m_previousMarker = marker1;
 					}
@@ -259,7 +278,7 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 						sf::Vector2f direction = normalize(mouseWorldPos - origin);
 
 						// Create the ray
-						RayData* ray = sCreateWhiteRay(origin, direction);
+						SlotHandle ray = sCreateWhiteRay(origin, direction);
 
 						// Update first marker role and ray link
 						m_previousMarker->cMarker = std::make_unique<CMarker>(RayTag(), MarkerRole::singleRayMarker1, ray);
@@ -282,15 +301,13 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 						sf::Color(255, 0, 0, 122),
 						sf::Color(255, 255, 255, 255),
 						45.0f);
-					pointLightMarker->cMarker = std::make_unique<CMarker>(RayTag(), MarkerRole::PointLightMarker, nullptr);
-					for (int i = 0; i < m_pointLightResolution; i++)
-					{
-						float angle = static_cast<float>(i) * (2 * pi / m_pointLightResolution);
-						sf::Vector2f dir = { std::cos(angle), std::sin(angle) };
-						sf::Vector2f rayOrigin = mouseWorldPos;
-						RayData* ray = sCreateWhiteRay(rayOrigin, dir);
-						pointLightMarker->cMarker->addTargetRay(ray);
-					}
+					Emitter pointLight;
+					pointLight.type = EmitterType::Point;
+					pointLight.origin = mouseWorldPos;
+					pointLight.rayCount = m_pointLightResolution;
+					pointLight.whiteLight = true;
+					SlotHandle emitter = sCreateEmitter(pointLight);
+					pointLightMarker->cMarker = std::make_unique<CMarker>(EmitterTag(), MarkerRole::PointLightMarker, emitter);
 					m_placingPointLight = false;
 					m_stateChange = true; 
 				}
@@ -300,15 +317,15 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 						sf::Color(255, 0, 0, 122),
 						sf::Color(255, 255, 255, 255),
 						45.0f);
-					pointLightMarker->cMarker = std::make_unique<CMarker>(RayTag(), MarkerRole::ColouredPointLightMarker, nullptr);
-					for (int i = 0; i < m_pointLightResolution; i++)
-					{
-						float angle = static_cast<float>(i) * (2 * pi / m_pointLightResolution);
-						sf::Vector2f dir = { std::cos(angle), std::sin(angle) };
-						sf::Vector2f rayOrigin = mouseWorldPos;
-						RayData* ray = sCreateColouredRay(rayOrigin, dir, m_wavelengthCreation);
-						pointLightMarker->cMarker->addTargetRay(ray);
-					}
+					Emitter pointLight;
+					pointLight.type = EmitterType::Point;
+					pointLight.origin = mouseWorldPos;
+					pointLight.rayCount = m_pointLightResolution;
+					pointLight.whiteLight = false;
+					pointLight.wavelength = m_wavelengthCreation;
+					pointLight.color = wavelengthToRGB(m_wavelengthCreation);
+					SlotHandle emitter = sCreateEmitter(pointLight);
+					pointLightMarker->cMarker = std::make_unique<CMarker>(EmitterTag(), MarkerRole::ColouredPointLightMarker, emitter);
 					m_placingColouredPointLight = false;
 					m_stateChange = true;
 
@@ -320,10 +337,11 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 						if (m_previousMarker->cMarker && m_previousMarker->cMarker->getRole() == MarkerRole::polygonPrismMarker)
 						{
 							Entity* customPrism = m_previousMarker->cMarker->getTargetEntity();
-							CustomPolygonPrism* customPrismShape = dynamic_cast<CustomPolygonPrism*>(customPrism->cCustomShape->customShape.get());
+							CustomPolygonPrism* customPrismShape = customPrism->cCustomShape->as<CustomPolygonPrism>();
 							if (magnitude(customPrismShape->getPoint(0) - mouseWorldPos) < 10.0f )
 							{
 								customPrismShape->setShapeComplete();
+								m_entities.refreshBounds(customPrism);
 								m_previousMarker = nullptr;
 							}
 							else
@@ -360,7 +378,7 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 				{
 					if (m_previousMarker)
 					{
-						auto arcShape = dynamic_cast<CircularArcShape*>(m_circularArcInProgress->cCustomShape->customShape.get());
+						auto arcShape = m_circularArcInProgress->cCustomShape->as<CircularArcShape>();
 						if (!arcShape)
 						{
 							std::cerr << "Error: cCustomShape is not a CircularArcShape\n";
@@ -369,7 +387,8 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 
 						if (arcShape->isComplete())
 						{
-							// Third click
+							// Third click, the last marker has been following the mouse so it needs re-indexing along with the arc
+							sRefreshPickBounds(m_circularArcInProgress);
 							m_previousMarker = nullptr;
 							m_circularArcInProgress = nullptr;
 						}
@@ -412,6 +431,68 @@ void Simulation::handleMousePressLeft(const std::optional<sf::Event> event, sf::
 						m_circularArcInProgress = arc;
 					}
 				}
+				else if (m_placingEmitter)
+				{
+					Entity* marker = sCreateMarker(mouseWorldPos, 2.5f, 4,
+						sf::Color(255, 0, 0, 122),
+						sf::Color(255, 255, 255, 255),
+						45.0f);
+
+					if (m_previousMarker == nullptr)
+					{
+						// First click is where the light comes from
+						Emitter settings = m_emitterSettings;
+						settings.origin = mouseWorldPos;
+						if (!settings.whiteLight)
+						{
+							settings.wavelength = m_wavelengthCreation;
+							settings.color = wavelengthToRGB(m_wavelengthCreation);
+						}
+						SlotHandle emitter = sCreateEmitter(settings);
+						marker->cMarker = std::make_unique<CMarker>(EmitterTag(), MarkerRole::EmitterMarker, emitter);
+
+						// Point emitters shine everywhere so don't need a direction
+						if (settings.type == EmitterType::Point)
+							m_placingEmitter = false;
+						else
+							m_previousMarker = marker;
+					}
+					else
+					{
+						// Second click is what it points at
+						SlotHandle emitterHandle = m_previousMarker->cMarker->getTargetEmitter();
+						Emitter* emitter = m_emitters.get(emitterHandle);
+						if (emitter && magnitude(mouseWorldPos - emitter->origin) > 1e-3f)
+							emitter->direction = normalize(mouseWorldPos - emitter->origin);
+						marker->cMarker = std::make_unique<CMarker>(EmitterTag(), MarkerRole::EmitterDirectionMarker, emitterHandle);
+						m_previousMarker = nullptr;
+						m_placingEmitter = false;
+					}
+				}
+				else if (m_placingDetector)
+				{
+					Entity* marker = sCreateMarker(mouseWorldPos, 2.5f, 4,
+						sf::Color(255, 0, 0, 122),
+						sf::Color(255, 255, 255, 255),
+						45.0f);
+
+					if (m_detectorInProgress == nullptr)
+					{
+						// First end of the detector
+						m_detectorInProgress = sCreateDetector(sf::Color(0, 255, 255, 255));
+					}
+					auto detectorShape = m_detectorInProgress->cCustomShape->as<DetectorShape>();
+					marker->cMarker = std::make_unique<CMarker>(EntityTag(), MarkerRole::DetectorMarker, m_detectorInProgress);
+					detectorShape->addMarker(marker);
+					m_entities.refreshBounds(m_detectorInProgress);
+
+					if (detectorShape->isComplete())
+					{
+						// Second end, detector is finished
+						m_detectorInProgress = nullptr;
+						m_placingDetector = false;
+					}
+				}
 
 
 			}
@@ -439,6 +520,9 @@ void Simulation::handleMouseButtonReleased(const std::optional <sf::Event> event
 		switch (mousePressed->button)
 		{
 		case sf::Mouse::Button::Left:
+			// Picking only happens on press so the moved entities only need re-indexing once the drag is over
+			if (m_isDragging || m_isRotating)
+				sRefreshPickBounds(m_selectedEntity);
 			m_isDragging = false;
 			m_isRotating = false;
 			break;
@@ -501,12 +585,12 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 		else if (m_selectedEntity->getTag() == "DemoPrism")
 		{
 			// Just update position
-			PrismDemoShape* prismShape = dynamic_cast<PrismDemoShape*>(m_selectedEntity->cCustomShape->customShape.get());
+			PrismDemoShape* prismShape = m_selectedEntity->cCustomShape->as<PrismDemoShape>();
 			prismShape->setPosition(mouseWorldPos + m_dragOffset);
 		}
 		else if (m_selectedEntity->getTag() == "CustomPolyPrism")
 		{
-			CustomPolygonPrism* customPrism = dynamic_cast<CustomPolygonPrism*>(m_selectedEntity->cCustomShape->customShape.get());
+			CustomPolygonPrism* customPrism = m_selectedEntity->cCustomShape->as<CustomPolygonPrism>();
 			customPrism->setPosition(mouseWorldPos + m_dragOffset);
 			customPrism->updateMarkerPositions();
 		}
@@ -514,7 +598,7 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 		{ 
 			// Just update position
 			m_selectedEntity->cCustomShape->customShape->setPosition(mouseWorldPos + m_dragOffset);
-			MyLensShape* lensShape = dynamic_cast<MyLensShape*>(m_selectedEntity->cCustomShape->customShape.get());
+			MyLensShape* lensShape = m_selectedEntity->cCustomShape->as<MyLensShape>();
 			lensShape->updateMarkers();
 		}
 		else if (m_selectedEntity->getTag() == "Marker")  // Just update position
@@ -530,7 +614,7 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					m_selectedEntity->cShape->circle.setPosition(sf::Vector2f(newX, currentPos.y));
 
 					Entity* lens = m_selectedEntity->cMarker->getTargetEntity();
-					MyLensShape* lensShape = dynamic_cast<MyLensShape*>(lens->cCustomShape->customShape.get());
+					MyLensShape* lensShape = lens->cCustomShape->as<MyLensShape>();
 					if (lensShape)  // Check cast succeeded
 					{
 						float deltaLeftInset = newX - currentPos.x;
@@ -544,7 +628,7 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					m_selectedEntity->cShape->circle.setPosition(sf::Vector2f(newX, currentPos.y));
 
 					Entity* lens = m_selectedEntity->cMarker->getTargetEntity();
-					MyLensShape* lensShape = dynamic_cast<MyLensShape*>(lens->cCustomShape->customShape.get());
+					MyLensShape* lensShape = lens->cCustomShape->as<MyLensShape>();
 					if (lensShape)  // Check cast succeeded
 					{
 						float deltaRightInset = currentPos.x - newX;
@@ -557,7 +641,7 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					sf::Vector2f newPos = mouseWorldPos + m_dragOffset;
 					m_selectedEntity->cShape->circle.setPosition(newPos);
 					Entity* lens = m_selectedEntity->cMarker->getTargetEntity();
-					MyLensShape* lensShape = dynamic_cast<MyLensShape*>(lens->cCustomShape->customShape.get());
+					MyLensShape* lensShape = lens->cCustomShape->as<MyLensShape>();
 					if (lensShape)  // Check cast succeeded
 					{
 						float deltaWidth = currentPos.x - newPos.x;
@@ -573,11 +657,11 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					m_selectedEntity->cShape->circle.setPosition(mouseWorldPos + m_dragOffset);
 					sf::Vector2f marker1Pos = m_selectedEntity->cShape->circle.getPosition();
 					sf::Vector2f marker2Pos = sf::Vector2f(0.0f, 0.0f);
-					for (auto& e : m_entities.getEntities())
+					for (auto& [marker, e] : m_entities.components<CMarker>())
 					{
-						if (e->cMarker && e->cMarker->getRole() == MarkerRole::singleRayMarker2 && (e->cMarker->getTargetRay() == m_selectedEntity->cMarker->getTargetRay()))
+						if (marker.getRole() == MarkerRole::singleRayMarker2 && (marker.getTargetRay() == m_selectedEntity->cMarker->getTargetRay()))
 						{
-							marker2Pos = e.get()->cShape->circle.getPosition();
+							marker2Pos = e->cShape->circle.getPosition();
 							break;
 						}
 					}
@@ -589,7 +673,7 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					{
 						m_stateChange = true;
 						sf::Vector2f newDirection = normalize(marker2Pos - marker1Pos);
-						RayData* ray = m_selectedEntity->cMarker->getTargetRay();
+						RayData* ray = m_lightSources.get(m_selectedEntity->cMarker->getTargetRay());
 						if (ray)
 						{
 							ray->originX = marker1Pos.x;
@@ -608,11 +692,11 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					m_selectedEntity->cShape->circle.setPosition(mouseWorldPos + m_dragOffset);
 					sf::Vector2f marker2Pos = m_selectedEntity->cShape->circle.getPosition();
 					sf::Vector2f marker1Pos = sf::Vector2f(0.0f, 0.0f);
-					for (auto& e : m_entities.getEntities())
+					for (auto& [marker, e] : m_entities.components<CMarker>())
 					{
-						if (e->cMarker && e->cMarker->getRole() == MarkerRole::singleRayMarker1 && (e->cMarker->getTargetRay() == m_selectedEntity->cMarker->getTargetRay()))
+						if (marker.getRole() == MarkerRole::singleRayMarker1 && (marker.getTargetRay() == m_selectedEntity->cMarker->getTargetRay()))
 						{
-							marker1Pos = e.get()->cShape->circle.getPosition();
+							marker1Pos = e->cShape->circle.getPosition();
 							break;
 						}
 					}
@@ -623,20 +707,76 @@ void Simulation::handleDragging(sf::Vector2f mouseWorldPos)
 					else
 					{
 						sf::Vector2f newDirection = normalize(marker2Pos - marker1Pos);
-						RayData* ray = m_selectedEntity->cMarker->getTargetRay();
-						ray->originX = marker1Pos.x;
-						ray->originY = marker1Pos.y;
-						ray->dirX = newDirection.x;
-						ray->dirY = newDirection.y;
+						if (RayData* ray = m_lightSources.get(m_selectedEntity->cMarker->getTargetRay()))
+						{
+							ray->originX = marker1Pos.x;
+							ray->originY = marker1Pos.y;
+							ray->dirX = newDirection.x;
+							ray->dirY = newDirection.y;
+						}
 					}
 				}
 				else if (markerRole == MarkerRole::CircularArcMarker)
 				{
 					Entity* arcEntity = m_selectedEntity->cMarker->getTargetEntity();
-					CircularArcShape* arcShape = dynamic_cast<CircularArcShape*>(arcEntity->cCustomShape->customShape.get());
+					CircularArcShape* arcShape = arcEntity->cCustomShape->as<CircularArcShape>();
 					arcShape->setMarkerPos(m_selectedEntity, mouseWorldPos);
 				}
+				else if (markerRole == MarkerRole::PointLightMarker || markerRole == MarkerRole::ColouredPointLightMarker)
+				{
+					// The whole light is just its emitter, the rays get regenerated on the GPU
+					m_selectedEntity->cShape->circle.setPosition(mouseWorldPos + m_dragOffset);
+					if (Emitter* emitter = m_emitters.get(m_selectedEntity->cMarker->getTargetEmitter()))
+						emitter->origin = m_selectedEntity->cShape->circle.getPosition();
+				}
+				else if (markerRole == MarkerRole::EmitterMarker || markerRole == MarkerRole::EmitterDirectionMarker)
+				{
+					m_selectedEntity->cShape->circle.setPosition(mouseWorldPos + m_dragOffset);
+					SlotHandle emitterHandle = m_selectedEntity->cMarker->getTargetEmitter();
+					Emitter* emitter = m_emitters.get(emitterHandle);
+					if (emitter)
+					{
+						// Find the other marker so the direction can be kept pointing at it, like the single ray markers
+						Entity* originMarker = nullptr;
+						Entity* directionMarker = nullptr;
+						for (auto& [marker, e] : m_entities.components<CMarker>())
+						{
+							if (marker.getTargetEmitter() == emitterHandle)
+							{
+								if (marker.getRole() == MarkerRole::EmitterMarker) originMarker = e;
+								else if (marker.getRole() == MarkerRole::EmitterDirectionMarker) directionMarker = e;
+							}
+						}
+						if (originMarker) emitter->origin = originMarker->cShape->circle.getPosition();
+						if (directionMarker)
+						{
+							sf::Vector2f towards = directionMarker->cShape->circle.getPosition() - emitter->origin;
+							if (magnitude(towards) > 1e-3f) emitter->direction = normalize(towards);
+						}
+					}
+				}
+				else if (markerRole == MarkerRole::DetectorMarker)
+				{
+					Entity* detectorEntity = m_selectedEntity->cMarker->getTargetEntity();
+					DetectorShape* detectorShape = detectorEntity->cCustomShape->as<DetectorShape>();
+					detectorShape->setMarkerPos(m_selectedEntity, mouseWorldPos + m_dragOffset);
+				}
 			}
 		}
 	}
 }
+
+void Simulation::sRefreshPickBounds(Entity* entity)
+{
+	if (!entity) return;
+	// A marker reshapes whatever it controls, and moving a shape carries its markers with it, so refresh the whole group
+	Entity* owner = (entity->cMarker && entity->cMarker->getTargetEntity()) ? entity->cMarker->getTargetEntity() : entity;
+	m_entities.refreshBounds(entity);
+	m_entities.refreshBounds(owner);
+	for (auto& [marker, e] : m_entities.components<CMarker>())
+	{
+		if (marker.getTargetEntity() == owner)
+			m_entities.refreshBounds(e);
+	}
+	m_entities.refreshBounds(m_rotator);
+}
@@ -66,3 +66,19 @@ ArcData arcFromThreePoints(const sf::Vector2f& A, const sf::Vector2f& B, const s
 
     return { radius, sweep, center };
 }
+
+unsigned int arcSegmentsForError(float radius, float angle, float maxError, unsigned int minSegments, unsigned int maxSegments)
+{
+    if (maxError <= 0.0f || radius <= 0.0f) return maxSegments;
+    // Also catches a NaN angle, which would otherwise end up cast to unsigned
+    if (!(std::abs(angle) > 0.0f)) return minSegments;
+
+    // A chord spanning dTheta sits r(1 - cos(dTheta/2)) from the arc at its middle, solve that for the widest allowed dTheta
+    float ratio = std::min(maxError / radius, 1.0f);
+    // 1 - ratio rounds to 1 in float for tiny ratios (huge radius) and acos gives 0, use the small angle form 1 - cos(x) ~ x^2 / 2 there
+    float maxStep = ratio < 1e-3f ? 2.0f * std::sqrt(2.0f * ratio) : 2.0f * std::acos(1.0f - ratio);
+    if (!(maxStep > 0.0f)) return maxSegments;
+    float segments = std::ceil(std::abs(angle) / maxStep);
+
+    return static_cast<unsigned int>(std::clamp(segments, static_cast<float>(minSegments), static_cast<float>(maxSegments)));
+}
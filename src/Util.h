@@ -7,4 +7,11 @@ struct ArcData {
     sf::Vector2f center;
 };
 
-ArcData arcFromThreePoints(const sf::Vector2f &, const sf::Vector2f &, const sf::Vector2f &);
\ No newline at end of file
+ArcData arcFromThreePoints(const sf::Vector2f &, const sf::Vector2f &, const sf::Vector2f &);
+
+// World units a curve's edges may stray from the true curve when nothing else has been set
+constexpr float defaultMaxChordError = 0.05f;
+
+// Fewest segments that approximate an arc with no chord further than maxError from the circle (its sagitta),
+// clamped to [minSegments, maxSegments]
+unsigned int arcSegmentsForError(float radius, float angle, float maxError, unsigned int minSegments, unsigned int maxSegments);
\ No newline at end of file
@@ -6,11 +6,13 @@
 #include "Util.h"
 #include "Entity.h"
 #include "earcut.hpp"
+#include "CachedVertices.h"
 
 
 class MyLensShape : public sf::Shape {
 public:
-    MyLensShape(const float width,const float height,const float leftInset,const float rightInset, Entity* , Entity* , Entity*,const sf::Vector2f & pos, const unsigned int resolution = 500);
+    static constexpr ShapeKind shapeKind = ShapeKind::Lens;
+    MyLensShape(const float width,const float height,const float leftInset,const float rightInset, Entity* , Entity* , Entity*,const sf::Vector2f & pos, const unsigned int resolution = 2048);
 
     virtual std::size_t getPointCount() const override;
     virtual sf::Vector2f getPoint(std::size_t index) const override;
@@ -23,6 +25,8 @@ public:
 	void setMarkerEntities(Entity* leftMarker, Entity* rightMarker, Entity* widthAndHeightMarker);
     void updateMarkers();
     void destroyMarkers();
+    // Returns true if the lens was re-tessellated
+    bool setMaxChordError(float maxError);
 
     float getLeftInset() const;
     float getRightInset() const;
@@ -31,7 +35,7 @@ public:
     
 private:
     void update();
-    void triangulate();
+    void triangulate() const;
     void sampleArc(std::vector<sf::Vector2f>& out,
         const sf::Vector2f& center,
         const sf::Vector2f& from,
@@ -43,9 +47,20 @@ private:
     Entity* m_rightMarker;
     Entity* m_widthAndHeightMarker;
     float leftInset, rightInset, m_width, m_height;
-    unsigned int m_resolution;
+    unsigned int m_resolution; // Most segments either curved side may use, the actual count comes from m_maxChordError
+    float m_maxChordError = defaultMaxChordError;
     std::vector<sf::Vector2f> m_points;
-    std::vector<uint32_t> m_indices;
+    // Only needed to draw, so filled in lazily by the first draw after the points change
+    mutable std::vector<uint32_t> m_indices;
+
+    // Built from m_points and m_indices when the geometry or colours change rather than every draw.
+    // A drag calls several setters per frame, each recomputing the points, but only the draw triangulates
+    mutable CachedVertices m_fillVertices{ sf::PrimitiveType::Triangles };
+    mutable CachedVertices m_outlineVertices{ sf::PrimitiveType::LineStrip };
+    mutable bool m_verticesDirty = true;
+    mutable sf::Color m_builtFillColor;
+    mutable sf::Color m_builtOutlineColor;
+    void rebuildVertices() const;
 
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
 
@@ -108,7 +108,7 @@ global float* createRayAtY,
 global float* createRayWithDirX,
 global float* createRayWithDirY,
 global bool* finishedProcessing,
-global  uint* screenBounds,
+global const float* worldBounds,
 global float* transmissionCoefficients
 ) {
 	const uint n = get_global_id(0);
@@ -193,16 +193,18 @@ global float* transmissionCoefficients
 	}
 	else
 	{
-		// --- Check intersection with screen bounds ---
-		float width = (float)screenBounds[0];
-		float height = (float)screenBounds[1];
+		// --- Check intersection with world bounds ---
+		float left = worldBounds[0];
+		float top = worldBounds[1];
+		float width = worldBounds[2];
+		float height = worldBounds[3];
 
-		// Define screen rectangle as 4 edges (in CCW order)
+		// Define world rectangle as 4 edges (in CCW order)
 		float2 screenVerts[4] = {
-			(float2)(0.0f, 0.0f),
-			(float2)(width, 0.0f),
-			(float2)(width, height),
-			(float2)(0.0f, height)
+			(float2)(left, top),
+			(float2)(left + width, top),
+			(float2)(left + width, top + height),
+			(float2)(left, top + height)
 		};
 
 		for (int i = 0; i < 4; ++i) 
@@ -228,24 +230,43 @@ global float* transmissionCoefficients
 
 		// FInished processing should be TRUE 
 		entityIndexHit[n] = -1; // No entity hit
-		collisionPointsX[n] = origin.x + minT * dir.x; // Collision point on screen bounds
-		collisionPointsY[n] = origin.y + minT * dir.y; // Collision point on screen bounds
+		collisionPointsX[n] = origin.x + minT * dir.x; // Collision point on world bounds
+		collisionPointsY[n] = origin.y + minT * dir.y; // Collision point on world bounds
 		finishedProcessing[n] = true; // Mark this ray as finished processing
 	}
 
 }
 
 )+R(float getMaterialIndex(
-global const float* sellmeierA,
-global const float* sellmeierB,
+constant const float* sellmeierA,
+constant const float* sellmeierB,
 global const int* entitySellmeierProfiles,
 int entityIndex,
-float wavelength
+float wavelengthNm,
+global const float* indexTable,
+const uint indexTableSize,
+const float indexTableStart,
+const float indexTableEnd
 ) {
-	// wavelength in micrometers 
-	float lambdaSq = wavelength * wavelength;
-
+	// With one glass in the scene its profile is compiled in and the lookup disappears
+)+"#ifdef SINGLE_MATERIAL"+R(
+	int profileIndex = SINGLE_MATERIAL;
+)+"#else"+R(
 	int profileIndex = entitySellmeierProfiles[entityIndex];
+)+"#endif"+R(
+
+	// Inside the spectrum white light covers, blend the two nearest samples of the material's table (see Simulation::uploadMaterials)
+	const float position = (wavelengthNm - indexTableStart) / (indexTableEnd - indexTableStart) * (float)(indexTableSize - 1u);
+	if (position >= 0.0f && position <= (float)(indexTableSize - 1u))
+	{
+		const uint sample = min((uint)position, indexTableSize - 2u);
+		global const float* table = indexTable + profileIndex * indexTableSize;
+		return mix(table[sample], table[sample + 1u], position - (float)sample);
+	}
+
+	// Monochromatic light can be set outside it, that works it out from the coefficients
+	float wavelength = wavelengthNm * 1e-3f; // wavelength in micrometers 
+	float lambdaSq = wavelength * wavelength;
 	int offset = profileIndex * 3;
 
 	float A0 = sellmeierA[offset];
@@ -271,62 +292,79 @@ float wavelength
 
 	return sqrt(nSquared);
 }
-) + R(kernel void ray_fresnel_mode(
-global const float* rayOriginsX,
-global const float* rayOriginsY,
-global float* rayDirsX,
-global float* rayDirsY,
-global float* reflectedRayDirsX,
-global float* reflectedRayDirsY,
+)+R(int hit_known_edge(
+const int edge,
+const float2 origin,
+const float2 rayDir,
 global const float* edgeA_X,
 global const float* edgeA_Y,
 global const float* edgeB_X,
 global const float* edgeB_Y,
 global const int* edgeEntityIndices,
-const uint edgeCount, 
+float* minT,
+float2* finalEdge,
+float* finalU
+) {
+	// Rays split off a white ray start just before the edge it hit, so the whole fan hits that edge first without searching the scene for it
+	// Returns the entity hit, or -1 if the ray misses the edge after all and has to search like any other
+	float2 a = (float2)(edgeA_X[edge], edgeA_Y[edge]);
+	float2 b = (float2)(edgeB_X[edge], edgeB_Y[edge]);
+	float2 e = b - a;
+	float2 pa = a - origin;
+
+	float det = rayDir.x * e.y - rayDir.y * e.x;
+	if (fabs(det) < 1e-6f) return -1;
+
+	float t = (pa.x * e.y - pa.y * e.x) / det;
+	float u = (pa.x * rayDir.y - pa.y * rayDir.x) / det;
+	if (!(t > 0.0f && u >= 0.0f && u <= 1.0f)) return -1;
+
+	*minT = t;
+	*finalEdge = e;
+	*finalU = u;
+	return edgeEntityIndices[edge];
+}
+
+) + R(void resolve_ray_hit(
+const uint n,
+const float2 origin,
+const float2 rayDir,
+float minT,
+const int hitEntity,
+float2 finalEdge,
+const float finalU,
+const int hitEdge,
+global float* rayDirsX,
+global float* rayDirsY,
+global float* reflectedRayDirsX,
+global float* reflectedRayDirsY,
 global float* collisionPointsX,
 global float* collisionPointsY,
 global int* entityIndexHit,
 global float* refracIndices,
 global bool* whiteLight,
 global bool* finishedProcessing,
-constant const uint * screenBounds,
+constant const float* worldBounds,
 global float* transmissionCoefficients,
-global const float* sellmeierCoefficientsA,
-global const float* sellmeierCoefficientsB,
+constant const float* sellmeierCoefficientsA,
+constant const float* sellmeierCoefficientsB,
 global const int* entitySellmeierProfiles,
-global const float* rayWavelengths
+global const float* rayWavelengths,
+global const float* rayIntensities,
+global ulong* detectorHistogram,
+const uint detectorPositionBins,
+const uint detectorWavelengthBins,
+const float detectorMinWavelength,
+const float detectorMaxWavelength,
+const float detectorEnergyScale,
+global const float* rayWavelengthSpans,
+global int* hitEdges,
+global const float* refractiveIndexTable,
+const uint indexTableSize,
+const float indexTableStart,
+const float indexTableEnd
 ) {
-	const uint n = get_global_id(0);
-
-	float2 origin = (float2)(rayOriginsX[n], rayOriginsY[n]);
-	float2 rayDir = fast_normalize((float2)(rayDirsX[n], rayDirsY[n]));
-
-	float minT = 1e20f;
-	int hitEntity = -1;
-
-	float2 finalEdge;
-
-	// Loop over all edges
-	for (uint i = 0; i < edgeCount; ++i) {
-		float2 a = (float2)(edgeA_X[i], edgeA_Y[i]);
-		float2 b = (float2)(edgeB_X[i], edgeB_Y[i]);
-		float2 edge = b - a;
-		float2 pa = a - origin;
-
-		float det = rayDir.x * edge.y - rayDir.y * edge.x;
-		if (fabs(det) < 1e-6f) continue;
-
-		float t = (pa.x * edge.y - pa.y * edge.x) / det;
-		float u = (pa.x * rayDir.y - pa.y * rayDir.x) / det;
-
-		if (t > 0.0f && u >= 0.0f && u <= 1.0f && t < minT) {
-			minT = t;
-			hitEntity = edgeEntityIndices[i];
-			finalEdge = edge;
-		}
-	}
-
+	// Everything after the closest edge is found, shared by every way of finding it
 	if (hitEntity != -1) {
 		float2 collisionPoint = origin + minT * rayDir;
 		entityIndexHit[n] = hitEntity;
@@ -335,7 +373,55 @@ global const float* rayWavelengths
 
 
 		float2 surfaceNormal = normalize((float2)(-finalEdge.y, finalEdge.x));
+		// The feature #defines come from Simulation::sCollisionv2 which compiles a variant without the branches the scene can't take
+)+"#ifndef NO_DETECTORS"+R(
+		if (entitySellmeierProfiles[hitEntity] <= -2)
+		{
+			// Detectors are stored as -2 - detectorIndex, they absorb the ray and bin its energy by where it landed and its wavelength
+			const uint detector = (uint)(-2 - entitySellmeierProfiles[hitEntity]);
+			const uint positionBin = min((uint)(finalU * (float)detectorPositionBins), detectorPositionBins - 1u);
+			const uint binStart = (detector * detectorPositionBins + positionBin) * detectorWavelengthBins;
+			const float energy = rayIntensities[n] * detectorEnergyScale;
+
+)+"#ifndef NO_WHITE_LIGHT"+R(
+			if (whiteLight[n])
+			{
+				// White light hasn't been split yet so it carries the whole spectrum equally
+				const ulong share = (ulong)(energy / (float)detectorWavelengthBins + 0.5f);
+				for (uint w = 0; w < detectorWavelengthBins; ++w)
+				{
+					atom_add(&detectorHistogram[binStart + w], share);
+				}
+			}
+			else if (rayWavelengthSpans[n] > 0.0f)
+			{
+				// A dispersion bundle that got here in one piece, its energy is spread evenly over its band the same way
+				const float binWidth = (detectorMaxWavelength - detectorMinWavelength) / (float)detectorWavelengthBins;
+				const float low = (rayWavelengths[n] - 0.5f * rayWavelengthSpans[n] - detectorMinWavelength) / binWidth;
+				const float high = (rayWavelengths[n] + 0.5f * rayWavelengthSpans[n] - detectorMinWavelength) / binWidth;
+				const uint firstBin = (uint)clamp(low, 0.0f, (float)(detectorWavelengthBins - 1u));
+				const uint lastBin = (uint)clamp(high, 0.0f, (float)(detectorWavelengthBins - 1u));
+				for (uint w = firstBin; w <= lastBin; ++w)
+				{
+					const float overlap = max(min(high, (float)(w + 1u)) - max(low, (float)w), 0.0f) / (high - low);
+					atom_add(&detectorHistogram[binStart + w], (ulong)(energy * overlap + 0.5f));
+				}
+			}
+			else
+)+"#endif"+R(
+			{
+				const float spectrumPosition = (rayWavelengths[n] - detectorMinWavelength) / (detectorMaxWavelength - detectorMinWavelength);
+				const uint wavelengthBin = (uint)clamp(spectrumPosition * (float)detectorWavelengthBins, 0.0f, (float)(detectorWavelengthBins - 1u));
+				atom_add(&detectorHistogram[binStart + wavelengthBin], (ulong)(energy + 0.5f));
+			}
+			finishedProcessing[n] = true;
+			return;
+		}
+)+"#endif"+R(
+)+"#ifndef NO_MIRRORS"+R(
+)+"#ifndef MIRRORS_ONLY"+R(
 		if (entitySellmeierProfiles[hitEntity] == -1)
+)+"#endif"+R(
 		{
 			// Then we are dealing with a mirror or something that doesn't have a refractive index, so just reflect the ray
 			float2 reflectedRay = only_reflect(rayDir, surfaceNormal);
@@ -344,7 +430,10 @@ global const float* rayWavelengths
 			finishedProcessing[n] = false;
 			return;
 		}
-		float n1 = getMaterialIndex(sellmeierCoefficientsA, sellmeierCoefficientsB, entitySellmeierProfiles, hitEntity, rayWavelengths[n] * 1e-3f);
+)+"#endif"+R(
+)+"#ifndef MIRRORS_ONLY"+R(
+		float n1 = getMaterialIndex(sellmeierCoefficientsA, sellmeierCoefficientsB, entitySellmeierProfiles, hitEntity, rayWavelengths[n],
+			refractiveIndexTable, indexTableSize, indexTableStart, indexTableEnd);
 
 		float n2 = 1.0f;
 		float cosTheta1 = dot(rayDir, -surfaceNormal);
@@ -356,18 +445,19 @@ global const float* rayWavelengths
 			cosTheta1 = -cosTheta1;
 		}
 
+)+"#ifndef NO_WHITE_LIGHT"+R(
 		if (whiteLight[n])
 		{
 			// For the amount of white rays (most of the time) even if we don't use the reflected Dir it should be trivial
 			float2 reflectedRay = only_reflect(rayDir, surfaceNormal);
 			reflectedRayDirsX[n] = reflectedRay.x;
 			reflectedRayDirsY[n] = reflectedRay.y;
+			hitEdges[n] = hitEdge; // The rays it splits into hit this edge first, see hit_known_edge
 			// We set it here but we can unset it if it hits a mirror entity 
 			finishedProcessing[n] = true;
 			return;
 		}
-
-
+)+"#endif"+R(
 
 		float3 refractedRay = only_refract(rayDir, surfaceNormal, n1, n2, cosTheta1);
 		rayDirsX[n] = refractedRay.x;
@@ -380,14 +470,15 @@ global const float* rayWavelengths
 		finishedProcessing[n] = false;
 
 		refracIndices[n] = n2; // update for next interaction
+)+"#endif"+R(
 
 	}
 	else {
-		// Fallback: check against screen bounds
-		float left = (float)screenBounds[0];
-		float top = (float)screenBounds[1];
-		float width = (float)screenBounds[2];
-		float height = (float)screenBounds[3];
+		// Fallback: stop at the world bounds, they don't move with the view so panning and zooming never need a re-trace
+		float left = worldBounds[0];
+		float top = worldBounds[1];
+		float width = worldBounds[2];
+		float height = worldBounds[3];
 
 		float2 screenVerts[4] = {
 			(float2)(left, top),
@@ -415,6 +506,8 @@ global const float* rayWavelengths
 			}
 		}
 
+		// Started outside the bounds heading away from them, don't draw it off to infinity
+		if (minT >= 1e20f) minT = 0.0f;
 		entityIndexHit[n] = -1;
 		collisionPointsX[n] = origin.x + minT * rayDir.x;
 		collisionPointsY[n] = origin.y + minT * rayDir.y;
@@ -422,4 +515,288 @@ global const float* rayWavelengths
 	}
 }
 
+) + R(kernel void ray_fresnel_mode(
+global const float* rayOriginsX,
+global const float* rayOriginsY,
+global float* rayDirsX,
+global float* rayDirsY,
+global float* reflectedRayDirsX,
+global float* reflectedRayDirsY,
+global const float* edgeA_X,
+global const float* edgeA_Y,
+global const float* edgeB_X,
+global const float* edgeB_Y,
+global const int* edgeEntityIndices,
+const uint edgeCount, 
+global float* collisionPointsX,
+global float* collisionPointsY,
+global int* entityIndexHit,
+global float* refracIndices,
+global bool* whiteLight,
+global bool* finishedProcessing,
+constant const float* worldBounds,
+global float* transmissionCoefficients,
+constant const float* sellmeierCoefficientsA,
+constant const float* sellmeierCoefficientsB,
+global const int* entitySellmeierProfiles,
+global const float* rayWavelengths,
+const uint firstRay, // Argument Simulation::firstRayArgument, traceSlice sets it and rayEnd per chunk so update that if arguments are added before it
+const uint rayEnd, // One past the last ray of this launch, big launches are split into chunks
+global const float* rayIntensities,
+global ulong* detectorHistogram,
+const uint detectorPositionBins,
+const uint detectorWavelengthBins,
+const float detectorMinWavelength,
+const float detectorMaxWavelength,
+const float detectorEnergyScale,
+global const float* rayWavelengthSpans,
+global const int* knownEdges,
+global int* hitEdges,
+global const float* refractiveIndexTable,
+const uint indexTableSize,
+const float indexTableStart,
+const float indexTableEnd
+) {
+	// Each work item traces every get_global_size(0)'th ray from firstRay, the launch tuner decides how many rays that is per item
+	// The loop condition also stops the extra items from rounding the global range up to the work group size adding stale rays to the detectors
+	for (uint n = firstRay + get_global_id(0); n < rayEnd; n += get_global_size(0))
+	{
+		float2 origin = (float2)(rayOriginsX[n], rayOriginsY[n]);
+		float2 rayDir = fast_normalize((float2)(rayDirsX[n], rayDirsY[n]));
+
+		float minT = 1e20f;
+		int hitEntity = -1;
+
+		float2 finalEdge;
+		float finalU = 0.0f; // How far along the hit edge the collision is, 0 at edge start and 1 at edge end
+		int finalEdgeIndex = knownEdges[n];
+		if (finalEdgeIndex >= 0)
+		{
+			hitEntity = hit_known_edge(finalEdgeIndex, origin, rayDir, edgeA_X, edgeA_Y, edgeB_X, edgeB_Y, edgeEntityIndices, &minT, &finalEdge, &finalU);
+		}
+
+		// Loop over all edges
+		const uint searchCount = hitEntity == -1 ? edgeCount : 0u;
+		for (uint i = 0; i < searchCount; ++i) {
+			float2 a = (float2)(edgeA_X[i], edgeA_Y[i]);
+			float2 b = (float2)(edgeB_X[i], edgeB_Y[i]);
+			float2 edge = b - a;
+			float2 pa = a - origin;
+
+			float det = rayDir.x * edge.y - rayDir.y * edge.x;
+			if (fabs(det) < 1e-6f) continue;
+
+			float t = (pa.x * edge.y - pa.y * edge.x) / det;
+			float u = (pa.x * rayDir.y - pa.y * rayDir.x) / det;
+
+			if (t > 0.0f && u >= 0.0f && u <= 1.0f && t < minT) {
+				minT = t;
+				hitEntity = edgeEntityIndices[i];
+				finalEdge = edge;
+				finalU = u;
+				finalEdgeIndex = (int)i;
+			}
+		}
+
+		resolve_ray_hit(n, origin, rayDir, minT, hitEntity, finalEdge, finalU, finalEdgeIndex,
+			rayDirsX, rayDirsY, reflectedRayDirsX, reflectedRayDirsY,
+			collisionPointsX, collisionPointsY, entityIndexHit, refracIndices, whiteLight, finishedProcessing,
+			worldBounds, transmissionCoefficients, sellmeierCoefficientsA, sellmeierCoefficientsB, entitySellmeierProfiles,
+			rayWavelengths, rayIntensities, detectorHistogram,
+			detectorPositionBins, detectorWavelengthBins, detectorMinWavelength, detectorMaxWavelength, detectorEnergyScale, rayWavelengthSpans, hitEdges,
+			refractiveIndexTable, indexTableSize, indexTableStart, indexTableEnd);
+	}
+}
+
+)+R(enum { EDGE_TILE_SIZE = 256 }; // Edges a work group holds in local memory at once, 5 KB
+
+)+R(kernel void ray_fresnel_mode_tiled(
+global const float* rayOriginsX,
+global const float* rayOriginsY,
+global float* rayDirsX,
+global float* rayDirsY,
+global float* reflectedRayDirsX,
+global float* reflectedRayDirsY,
+global const float* edgeA_X,
+global const float* edgeA_Y,
+global const float* edgeB_X,
+global const float* edgeB_Y,
+global const int* edgeEntityIndices,
+const uint edgeCount, 
+global float* collisionPointsX,
+global float* collisionPointsY,
+global int* entityIndexHit,
+global float* refracIndices,
+global bool* whiteLight,
+global bool* finishedProcessing,
+constant const float* worldBounds,
+global float* transmissionCoefficients,
+constant const float* sellmeierCoefficientsA,
+constant const float* sellmeierCoefficientsB,
+global const int* entitySellmeierProfiles,
+global const float* rayWavelengths,
+const uint firstRay, // Argument Simulation::firstRayArgument, traceSlice sets it and rayEnd per chunk so update that if arguments are added before it
+const uint rayEnd, // One past the last ray of this launch, big launches are split into chunks
+global const float* rayIntensities,
+global ulong* detectorHistogram,
+const uint detectorPositionBins,
+const uint detectorWavelengthBins,
+const float detectorMinWavelength,
+const float detectorMaxWavelength,
+const float detectorEnergyScale,
+global const float* rayWavelengthSpans,
+global const int* knownEdges,
+global int* hitEdges,
+global const float* refractiveIndexTable,
+const uint indexTableSize,
+const float indexTableStart,
+const float indexTableEnd
+) {
+	// Same result as ray_fresnel_mode, but the work group loads EDGE_TILE_SIZE edges into local memory together and tests all of its rays against them
+	// so each edge is read from global memory once per work group rather than once per ray
+	local float tileAX[EDGE_TILE_SIZE];
+	local float tileAY[EDGE_TILE_SIZE];
+	local float tileBX[EDGE_TILE_SIZE];
+	local float tileBY[EDGE_TILE_SIZE];
+	local int tileEntity[EDGE_TILE_SIZE];
+
+	const uint lid = get_local_id(0);
+	const uint groupSize = get_local_size(0);
+	// groupStart is the same for the whole group so every item goes round the loop, and reaches the barriers, the same number of times
+	for (uint groupStart = firstRay + get_group_id(0) * groupSize; groupStart < rayEnd; groupStart += get_global_size(0))
+	{
+		const uint n = groupStart + lid;
+		const bool active = n < rayEnd; // Items past the end still have to help load the tiles
+
+		float2 origin = (float2)(0.0f, 0.0f);
+		float2 rayDir = (float2)(1.0f, 0.0f);
+		if (active)
+		{
+			origin = (float2)(rayOriginsX[n], rayOriginsY[n]);
+			rayDir = fast_normalize((float2)(rayDirsX[n], rayDirsY[n]));
+		}
+
+		float minT = 1e20f;
+		int hitEntity = -1;
+
+		float2 finalEdge = (float2)(0.0f, 0.0f);
+		float finalU = 0.0f;
+		int finalEdgeIndex = active ? knownEdges[n] : -1;
+		if (finalEdgeIndex >= 0)
+		{
+			hitEntity = hit_known_edge(finalEdgeIndex, origin, rayDir, edgeA_X, edgeA_Y, edgeB_X, edgeB_Y, edgeEntityIndices, &minT, &finalEdge, &finalU);
+		}
+		const bool search = active && hitEntity == -1; // Fans still help load the tiles, they just don't test them
+
+		for (uint tileStart = 0; tileStart < edgeCount; tileStart += EDGE_TILE_SIZE)
+		{
+			const uint tileCount = min((uint)EDGE_TILE_SIZE, edgeCount - tileStart);
+			barrier(CLK_LOCAL_MEM_FENCE); // Nobody is still reading the last tile
+			for (uint j = lid; j < tileCount; j += groupSize)
+			{
+				tileAX[j] = edgeA_X[tileStart + j];
+				tileAY[j] = edgeA_Y[tileStart + j];
+				tileBX[j] = edgeB_X[tileStart + j];
+				tileBY[j] = edgeB_Y[tileStart + j];
+				tileEntity[j] = edgeEntityIndices[tileStart + j];
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+			if (!search) continue;
+
+			for (uint i = 0; i < tileCount; ++i) {
+				float2 a = (float2)(tileAX[i], tileAY[i]);
+				float2 b = (float2)(tileBX[i], tileBY[i]);
+				float2 edge = b - a;
+				float2 pa = a - origin;
+
+				float det = rayDir.x * edge.y - rayDir.y * edge.x;
+				if (fabs(det) < 1e-6f) continue;
+
+				float t = (pa.x * edge.y - pa.y * edge.x) / det;
+				float u = (pa.x * rayDir.y - pa.y * rayDir.x) / det;
+
+				if (t > 0.0f && u >= 0.0f && u <= 1.0f && t < minT) {
+					minT = t;
+					hitEntity = tileEntity[i];
+					finalEdge = edge;
+					finalU = u;
+					finalEdgeIndex = (int)(tileStart + i);
+				}
+			}
+		}
+
+		if (!active) continue;
+		resolve_ray_hit(n, origin, rayDir, minT, hitEntity, finalEdge, finalU, finalEdgeIndex,
+			rayDirsX, rayDirsY, reflectedRayDirsX, reflectedRayDirsY,
+			collisionPointsX, collisionPointsY, entityIndexHit, refracIndices, whiteLight, finishedProcessing,
+			worldBounds, transmissionCoefficients, sellmeierCoefficientsA, sellmeierCoefficientsB, entitySellmeierProfiles,
+			rayWavelengths, rayIntensities, detectorHistogram,
+			detectorPositionBins, detectorWavelengthBins, detectorMinWavelength, detectorMaxWavelength, detectorEnergyScale, rayWavelengthSpans, hitEdges,
+			refractiveIndexTable, indexTableSize, indexTableStart, indexTableEnd);
+	}
+}
+
+)+R(kernel void generate_emitter_rays(
+global float* rayOriginsX,
+global float* rayOriginsY,
+global float* rayDirsX,
+global float* rayDirsY,
+global bool* whiteLight,
+global float* refracIndices,
+global float* rayWavelengths,
+global float* rayIntensities,
+global bool* finishedProcessing,
+const uint firstRay,
+const uint rayCount,
+const int emitterType,
+const float originX,
+const float originY,
+const float dirX,
+const float dirY,
+const float width,
+const float halfAngle,
+const uint isWhiteLight,
+const float wavelength
+) {
+	const uint i = get_global_id(0);
+	if (i >= rayCount) return;
+	const uint n = firstRay + i;
+
+	// Centre of the i'th of rayCount equal slices of [0,1] so the rays sit symmetrically about the emitter's direction
+	const float t = ((float)i + 0.5f) / (float)rayCount;
+	const float2 across = (float2)(-dirY, dirX);
+	float2 origin = (float2)(originX, originY);
+	float angle = atan2(dirY, dirX);
+
+	if (emitterType == 0) // Point
+	{
+		angle = (float)i * (2.0f * M_PI_F / (float)rayCount);
+	}
+	else if (emitterType == 1) // Collimated
+	{
+		origin += across * ((t - 0.5f) * width);
+	}
+	else if (emitterType == 2) // Cone
+	{
+		angle += (2.0f * t - 1.0f) * halfAngle;
+	}
+	else // Area
+	{
+		// Spreading angle with t as well would make neighbouring rays parallel, so scramble it with the golden ratio (Fibonacci hashing)
+		origin += across * ((t - 0.5f) * width);
+		const float s = (float)(i * 2654435769u) * 2.3283064e-10f;
+		angle += (2.0f * s - 1.0f) * halfAngle;
+	}
+
+	rayOriginsX[n] = origin.x;
+	rayOriginsY[n] = origin.y;
+	rayDirsX[n] = cos(angle);
+	rayDirsY[n] = sin(angle);
+	whiteLight[n] = isWhiteLight != 0u;
+	refracIndices[n] = 1.0f;
+	rayWavelengths[n] = wavelength;
+	rayIntensities[n] = 1.0f;
+	finishedProcessing[n] = false;
+}
+
 );} // ############################################################### end of OpenCL C code #####################################################################
\ No newline at end of file
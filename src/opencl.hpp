@@ -14,6 +14,10 @@
 #endif // macOS
 #include <CL/opencl.hpp>
 #include "utilities.hpp"
+#include <map>
+#include <fstream>
+#include <filesystem>
+#include <future>
 using cl::Event;
 
 static const string driver_installation_instructions =
@@ -276,6 +280,70 @@ private:
 	cl::Program cl_program;
 	cl::CommandQueue cl_queue;
 	bool exists = false;
+	string opencl_c_code = ""; // kept so variants of the program can be compiled later
+	std::map<string, cl::Program> variant_programs; // programs compiled with extra #defines, keyed by those #define lines ("" is the generic program)
+	std::map<string, std::shared_future<std::pair<cl::Program, int>>> pending_variants; // variants still compiling in the background, with their error code
+	inline cl::Program finish_variant(const string& defines, const std::pair<cl::Program, int>& build) { // file a finished background compile under its defines
+		cl::Program program = build.first;
+		if(build.second) {
+			print_warning("OpenCL C code variant failed to compile with error code "+to_string(build.second)+", using the generic program instead.");
+			program = variant_programs[""];
+		}
+		pending_variants.erase(defines);
+		return variant_programs.emplace(defines, program).first->second;
+	}
+	string active_variant = "";
+	inline string program_cache_path(const string& kernel_code, const string& build_options) const { // compiled binaries are keyed by everything they depend on: device, driver, build options and the exact source
+		const string key = info.name+"\n"+info.driver_version+"\n"+build_options+"\n"+kernel_code;
+		ulong hash = 14695981039346656037ull; // 64-bit FNV-1a
+		for(const char c : key) { hash ^= (ulong)(uchar)c; hash *= 1099511628211ull; }
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+		return "kernel_cache/"+string(name)+".bin";
+	}
+	inline bool load_cached_program(const string& path, const string& build_options, cl::Program& program) const { // returns false if there is no usable binary, in which case the program has to be compiled from source
+		std::ifstream file(path, std::ios::binary);
+		if(!file) return false;
+		const vector<unsigned char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if(binary.empty()) return false;
+		vector<cl_int> binary_status;
+		cl_int error = 0;
+		program = cl::Program(info.cl_context, { info.cl_device }, cl::Program::Binaries{ binary }, &binary_status, &error);
+		if(error||binary_status.empty()||binary_status[0]!=CL_SUCCESS) return false; // stale or corrupt binary
+		return program.build({ info.cl_device }, (build_options+" -w").c_str())==CL_SUCCESS; // still has to be "built", but this only links the binary
+	}
+	inline void save_cached_program(const string& path, const cl::Program& program) const {
+		const vector<vector<unsigned char>> binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+		if(binaries.empty()||binaries[0].empty()) return;
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+		std::ofstream file(path, std::ios::binary);
+		file.write((const char*)binaries[0].data(), (std::streamsize)binaries[0].size());
+	}
+	inline cl::Program build_program(const string& defines, int& error) const {
+		const string kernel_code = enable_device_capabilities()+defines+"\n"+opencl_c_code;
+		const string build_options = "-cl-std=CL"+info.opencl_c_version+" -cl-finite-math-only -cl-no-signed-zeros -cl-mad-enable"+(info.patch_intel_gpu_above_4gb ? " -cl-intel-greater-than-4GB-buffer-required" : "");
+		const string cache_path = program_cache_path(kernel_code, build_options);
+		cl::Program program;
+		if(load_cached_program(cache_path, build_options, program)) { // skips the compile entirely, milliseconds instead of seconds
+			error = 0;
+			return program;
+		}
+		cl::Program::Sources cl_source;
+		cl_source.push_back({ kernel_code.c_str(), kernel_code.length() });
+		program = cl::Program(info.cl_context, cl_source);
+#ifndef LOG
+		error = program.build({ info.cl_device }, (build_options+" -w").c_str()); // compile OpenCL C code, disable warnings
+		if(error) print_warning(program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(info.cl_device)); // print build log
+#else // LOG, generate logfile for OpenCL code compilation
+		error = program.build({ info.cl_device }, build_options.c_str()); // compile OpenCL C code
+		const string log = program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(info.cl_device);
+		write_file("bin/kernel.log", log); // save build log
+		if((uint)log.length()>2u) print_warning(log); // print build log
+#endif // LOG
+		if(!error) save_cached_program(cache_path, program);
+		return program;
+	}
 	inline string enable_device_capabilities() const { return // enable FP64/FP16 capabilities if available
 		string(info.patch_nvidia_fp16         ? "\n #define cl_khr_fp16"                : "")+ // Nvidia Pascal and newer GPUs with driver>=520.00 don't report cl_khr_fp16, but do support basic FP16 arithmetic
 		string(info.patch_legacy_gpu_fma      ? "\n #define fma(a, b, c) ((a)*(b)+(c))" : "")+ // some old GPUs have terrible fma performance, so replace with a*b+c
@@ -297,28 +365,48 @@ public:
 	inline Device(const Device_Info& info, const string& opencl_c_code=get_opencl_c_code()) {
 		print_device_info(info);
 		this->info = info;
+		this->opencl_c_code = opencl_c_code;
 		this->cl_queue = cl::CommandQueue(info.cl_context, info.cl_device); // queue to push commands for the device
-		cl::Program::Sources cl_source;
-		const string kernel_code = enable_device_capabilities()+"\n"+opencl_c_code;
-		cl_source.push_back({ kernel_code.c_str(), kernel_code.length() });
-		this->cl_program = cl::Program(info.cl_context, cl_source);
-		const string build_options = "-cl-std=CL"+info.opencl_c_version+" -cl-finite-math-only -cl-no-signed-zeros -cl-mad-enable"+(info.patch_intel_gpu_above_4gb ? " -cl-intel-greater-than-4GB-buffer-required" : "");
-#ifndef LOG
-		int error = cl_program.build({ info.cl_device }, (build_options+" -w").c_str()); // compile OpenCL C code, disable warnings
-		if(error) print_warning(cl_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(info.cl_device)); // print build log
-#else // LOG, generate logfile for OpenCL code compilation
-		int error = cl_program.build({ info.cl_device }, build_options.c_str()); // compile OpenCL C code
-		const string log = cl_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(info.cl_device);
-		write_file("bin/kernel.log", log); // save build log
-		if((uint)log.length()>2u) print_warning(log); // print build log
-#endif // LOG
+		int error = 0;
+		this->cl_program = build_program("", error);
 		if(error) print_error("OpenCL C code compilation failed with error code "+to_string(error)+". Make sure there are no errors in kernel.cpp.");
 		else print_info("OpenCL C code successfully compiled.");
 #ifdef PTX // generate assembly (ptx) file for OpenCL code
 		write_file("bin/kernel.ptx", (char*)&cl_program.getInfo<CL_PROGRAM_BINARIES>()[0][0]); // save binary (ptx file)
 #endif // PTX
+		variant_programs[""] = cl_program;
 		this->exists = true;
 	}
+	inline void prepare_variant(const string& defines) { // start compiling a variant on another thread so use_variant doesn't stall on it later, does nothing if it's already compiled or compiling
+		if(variant_programs.count(defines)||pending_variants.count(defines)) return;
+		pending_variants.emplace(defines, std::async(std::launch::async, [this, defines]() {
+			int error = 0;
+			cl::Program program = build_program(defines, error);
+			return std::make_pair(program, error);
+		}).share());
+	}
+	inline bool is_variant_ready(const string& defines) { // whether use_variant(defines) can switch straight away, picks up a background compile that has finished
+		if(variant_programs.count(defines)) return true;
+		auto pending = pending_variants.find(defines);
+		if(pending==pending_variants.end()||pending->second.wait_for(std::chrono::seconds(0))!=std::future_status::ready) return false;
+		finish_variant(defines, pending->second.get());
+		return true;
+	}
+	inline void use_variant(const string& defines) { // switch the program new Kernels are made from to one compiled with extra "#define ..." lines, compiled the first time each set of defines is used
+		auto variant = variant_programs.find(defines);
+		if(variant!=variant_programs.end()) {
+			cl_program = variant->second;
+		} else {
+			auto pending = pending_variants.find(defines);
+			if(pending==pending_variants.end()) {
+				prepare_variant(defines);
+				pending = pending_variants.find(defines);
+			}
+			cl_program = finish_variant(defines, pending->second.get()); // waits if it's still compiling
+		}
+		active_variant = defines;
+	}
+	inline const string& get_variant() const { return active_variant; }
 	inline Device() {} // default constructor
 	inline void barrier(const vector<Event>* event_waitlist=nullptr, Event* event_returned=nullptr) { cl_queue.enqueueBarrierWithWaitList(event_waitlist, event_returned); }
 	inline void finish_queue() { cl_queue.finish(); }